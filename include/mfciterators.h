@@ -8,6 +8,37 @@
 #pragma once
 
 #include <assert.h>
+#include <vector>
+#include <algorithm>
+#include <type_traits>
+#include <atomic>
+#include <thread>
+#include <exception>
+#include <memory>
+#include <chrono>
+#include <limits>
+#include <mutex>
+#include <condition_variable>
+#include <future>
+#include <functional>
+#include <deque>
+#include <new>
+#include <cstddef>
+#include <shared_mutex>
+
+#if (defined(_MSVC_LANG) && _MSVC_LANG >= 201703L) || __cplusplus >= 201703L
+#include <string_view>
+#define MFC_HAS_STRING_VIEW
+#define MFC_HAS_SHARED_MUTEX
+#endif
+
+#if defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2) || defined(__SSE2__)
+#include <emmintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#define MFC_HAS_SSE2
+#endif
 
 #pragma region array iterators
 
@@ -1345,3 +1376,5567 @@ inline CTypeMapConstIterator<CMapWordToPtr, WORD, void*> end(CMapWordToPtr const
 }
 
 #pragma endregion
+
+#pragma region perfect hash map
+
+namespace mfc
+{
+   namespace detail
+   {
+      inline ULONGLONG mix_hash(ULONGLONG h) noexcept
+      {
+         h ^= h >> 33;
+         h *= 0xff51afd7ed558ccdULL;
+         h ^= h >> 33;
+         h *= 0xc4ceb9fe1a85ec53ULL;
+         h ^= h >> 33;
+         return h;
+      }
+
+      inline ULONGLONG hash_value(LPCTSTR key, ULONGLONG const seed) noexcept
+      {
+         ULONGLONG h = 0xcbf29ce484222325ULL ^ seed;
+         for (; *key != 0; ++key)
+         {
+            h ^= static_cast<ULONGLONG>(*key);
+            h *= 0x100000001b3ULL;
+         }
+         return mix_hash(h);
+      }
+
+      inline ULONGLONG hash_value(CString const & key, ULONGLONG const seed) noexcept
+      {
+         return hash_value(static_cast<LPCTSTR>(key), seed);
+      }
+
+      template <typename TKey>
+      inline typename std::enable_if<std::is_integral<TKey>::value || std::is_enum<TKey>::value, ULONGLONG>::type
+         hash_value(TKey const key, ULONGLONG const seed) noexcept
+      {
+         return mix_hash(static_cast<ULONGLONG>(key) ^ seed);
+      }
+
+      // pointers hash by address; character pointers are strings and go to the LPCTSTR overload
+      template <typename TKey>
+      inline typename std::enable_if<!std::is_same<typename std::remove_cv<TKey>::type, TCHAR>::value, ULONGLONG>::type
+         hash_value(TKey* const key, ULONGLONG const seed) noexcept
+      {
+         return mix_hash(static_cast<ULONGLONG>(reinterpret_cast<UINT_PTR>(key)) ^ seed);
+      }
+
+      template <typename T>
+      struct is_tchar_pointer : std::integral_constant<bool,
+         std::is_pointer<typename std::decay<T>::type>::value &&
+         std::is_same<typename std::remove_cv<typename std::remove_pointer<typename std::decay<T>::type>::type>::type, TCHAR>::value>
+      {
+      };
+
+      // key comparison consistent with hash_value: character pointers compare as strings
+      template <typename A, typename B>
+      inline typename std::enable_if<is_tchar_pointer<A>::value && is_tchar_pointer<B>::value, bool>::type
+         keys_equal(A const & a, B const & b) noexcept
+      {
+         return _tcscmp(a, b) == 0;
+      }
+
+      template <typename A, typename B>
+      inline typename std::enable_if<!(is_tchar_pointer<A>::value && is_tchar_pointer<B>::value), bool>::type
+         keys_equal(A const & a, B const & b)
+      {
+         return a == b;
+      }
+   }
+
+   // Minimal perfect hash table (hash-and-displace) built once from a populated map.
+   // Every key maps to its own slot, so a lookup is one hash, one displacement read and one key compare.
+   template <typename TKey, typename TValue>
+   class CPerfectHashMap
+   {
+   public:
+      typedef CMapPair<TKey, TValue>   pair_type;
+      typedef pair_type const *        const_iterator;
+
+      enum : DWORD { Signature = 0x31484D50 /* 'PMH1' */ };
+
+      CPerfectHashMap() = default;
+
+      template <typename M>
+      explicit CPerfectHashMap(M const & map)
+      {
+         Build(map);
+      }
+
+      template <typename M>
+      void Build(M const & map)
+      {
+         std::vector<pair_type> entries;
+         entries.reserve(static_cast<size_t>(map.GetCount()));
+         for (auto const & kvp : map)
+            entries.push_back(pair_type{ kvp.key, kvp.value });
+
+         Build(entries);
+      }
+
+      void Build(std::vector<pair_type> const & entries)
+      {
+         INT_PTR const count = static_cast<INT_PTR>(entries.size());
+         INT_PTR const buckets = count == 0 ? 0 : (count + KeysPerBucket - 1) / KeysPerBucket;
+
+         std::vector<ULONGLONG> hashes(entries.size());
+         std::vector<DWORD> displacements(static_cast<size_t>(buckets));
+         std::vector<INT_PTR> slots(entries.size());
+
+         for (ULONGLONG attempt = 0; ; ++attempt)
+         {
+            // duplicate keys can never be placed; a failure after that many seeds means the hash is degenerate
+            if (attempt == MaxAttempts)
+               AfxThrowNotSupportedException();
+
+            ULONGLONG const seed = detail::mix_hash(attempt + 0x9e3779b97f4a7c15ULL);
+            for (size_t i = 0; i < entries.size(); ++i)
+               hashes[i] = detail::hash_value(entries[i].key, seed);
+
+            if (attempt == 0 && HasDuplicateKeys(entries, hashes))
+            {
+               ASSERT(FALSE);
+               AfxThrowInvalidArgException();
+            }
+
+            if (Place(hashes, buckets, displacements, slots))
+            {
+               m_seed = seed;
+               break;
+            }
+         }
+
+         m_displacements.SetSize(buckets);
+         if (buckets > 0)
+            std::copy(displacements.begin(), displacements.end(), m_displacements.GetData());
+
+         m_entries.RemoveAll();
+         m_entries.SetSize(count);
+         for (size_t i = 0; i < entries.size(); ++i)
+            m_entries[slots[i]] = entries[i];
+      }
+
+      INT_PTR GetCount() const noexcept { return m_entries.GetCount(); }
+      INT_PTR GetSize() const noexcept { return m_entries.GetSize(); }
+      bool IsEmpty() const noexcept { return m_entries.IsEmpty() != FALSE; }
+
+      template <typename TKeyArg>
+      pair_type const * PLookup(TKeyArg const & key) const
+      {
+         if (m_entries.IsEmpty())
+            return nullptr;
+
+         pair_type const & entry = m_entries[SlotOf(detail::hash_value(key, m_seed))];
+         return detail::keys_equal(entry.key, key) ? &entry : nullptr;
+      }
+
+      template <typename TKeyArg>
+      BOOL Lookup(TKeyArg const & key, TValue& value) const
+      {
+         pair_type const * entry = PLookup(key);
+         if (entry == nullptr)
+            return FALSE;
+
+         value = entry->value;
+         return TRUE;
+      }
+
+      const_iterator begin() const noexcept { return m_entries.GetData(); }
+      const_iterator end() const noexcept { return m_entries.GetData() + m_entries.GetSize(); }
+
+      void Serialize(CArchive& ar)
+      {
+         if (ar.IsStoring())
+         {
+            ar << static_cast<DWORD>(Signature);
+            ar << m_seed;
+            ar.WriteCount(m_displacements.GetSize());
+            ar.WriteCount(m_entries.GetSize());
+            if (!m_displacements.IsEmpty())
+               ar.Write(m_displacements.GetData(), static_cast<UINT>(m_displacements.GetSize() * sizeof(DWORD)));
+
+            for (INT_PTR i = 0; i < m_entries.GetSize(); ++i)
+            {
+               SerializeElements<TKey>(ar, &m_entries[i].key, 1);
+               SerializeElements<TValue>(ar, &m_entries[i].value, 1);
+            }
+         }
+         else
+         {
+            DWORD signature = 0;
+            ar >> signature;
+            if (signature != Signature)
+               AfxThrowArchiveException(CArchiveException::badSchema);
+
+            ar >> m_seed;
+            INT_PTR const buckets = static_cast<INT_PTR>(ar.ReadCount());
+            INT_PTR const count = static_cast<INT_PTR>(ar.ReadCount());
+
+            m_displacements.SetSize(buckets);
+            UINT const bytes = static_cast<UINT>(buckets * sizeof(DWORD));
+            if (buckets > 0 && ar.Read(m_displacements.GetData(), bytes) != bytes)
+               AfxThrowArchiveException(CArchiveException::endOfFile);
+
+            m_entries.RemoveAll();
+            m_entries.SetSize(count);
+            for (INT_PTR i = 0; i < count; ++i)
+            {
+               SerializeElements<TKey>(ar, &m_entries[i].key, 1);
+               SerializeElements<TValue>(ar, &m_entries[i].value, 1);
+            }
+         }
+      }
+
+   private:
+      enum : INT_PTR { KeysPerBucket = 4 };
+      enum : DWORD { MaxDisplacement = 1u << 20 };
+      enum : ULONGLONG { MaxAttempts = 64 };
+
+      // equal keys have equal hashes, so only keys whose hashes collide are compared
+      static bool HasDuplicateKeys(std::vector<pair_type> const & entries, std::vector<ULONGLONG> const & hashes)
+      {
+         std::vector<size_t> order(entries.size());
+         for (size_t i = 0; i < order.size(); ++i) order[i] = i;
+         std::sort(order.begin(), order.end(), [&hashes](size_t const a, size_t const b) { return hashes[a] < hashes[b]; });
+
+         for (size_t i = 1; i < order.size(); ++i)
+         {
+            for (size_t j = i; j > 0 && hashes[order[j - 1]] == hashes[order[i]]; --j)
+               if (detail::keys_equal(entries[order[j - 1]].key, entries[order[i]].key))
+                  return true;
+         }
+
+         return false;
+      }
+
+      INT_PTR BucketOf(ULONGLONG const hash) const noexcept
+      {
+         return static_cast<INT_PTR>((hash >> 32) % static_cast<ULONGLONG>(m_displacements.GetSize()));
+      }
+
+      static INT_PTR SlotOf(ULONGLONG const hash, DWORD const displacement, INT_PTR const count) noexcept
+      {
+         return static_cast<INT_PTR>(detail::mix_hash(hash + displacement * 0x9e3779b97f4a7c15ULL) % static_cast<ULONGLONG>(count));
+      }
+
+      INT_PTR SlotOf(ULONGLONG const hash) const noexcept
+      {
+         return SlotOf(hash, m_displacements[BucketOf(hash)], m_entries.GetSize());
+      }
+
+      static bool Place(
+         std::vector<ULONGLONG> const & hashes,
+         INT_PTR const buckets,
+         std::vector<DWORD>& displacements,
+         std::vector<INT_PTR>& slots)
+      {
+         INT_PTR const count = static_cast<INT_PTR>(hashes.size());
+         if (count == 0)
+            return true;
+
+         std::fill(displacements.begin(), displacements.end(), 0);
+
+         std::vector<std::vector<size_t>> members(static_cast<size_t>(buckets));
+         for (size_t i = 0; i < hashes.size(); ++i)
+            members[static_cast<size_t>((hashes[i] >> 32) % static_cast<ULONGLONG>(buckets))].push_back(i);
+
+         std::vector<size_t> order(members.size());
+         for (size_t b = 0; b < order.size(); ++b) order[b] = b;
+         std::stable_sort(order.begin(), order.end(),
+            [&members](size_t const a, size_t const b) { return members[a].size() > members[b].size(); });
+
+         std::vector<bool> taken(static_cast<size_t>(count), false);
+         std::vector<INT_PTR> candidate;
+
+         for (size_t const b : order)
+         {
+            std::vector<size_t> const & keys = members[b];
+            if (keys.empty())
+               break;
+
+            bool placed = false;
+            for (DWORD d = 0; d < MaxDisplacement && !placed; ++d)
+            {
+               candidate.clear();
+               placed = true;
+               for (size_t const k : keys)
+               {
+                  INT_PTR const slot = SlotOf(hashes[k], d, count);
+                  if (taken[slot] || std::find(candidate.begin(), candidate.end(), slot) != candidate.end())
+                  {
+                     placed = false;
+                     break;
+                  }
+                  candidate.push_back(slot);
+               }
+
+               if (placed)
+               {
+                  displacements[b] = d;
+                  for (size_t i = 0; i < keys.size(); ++i)
+                  {
+                     taken[candidate[i]] = true;
+                     slots[keys[i]] = candidate[i];
+                  }
+               }
+            }
+
+            if (!placed)
+               return false;
+         }
+
+         return true;
+      }
+
+      ULONGLONG               m_seed = 0;
+      CArray<DWORD, DWORD>    m_displacements;
+      CArray<pair_type, pair_type const &> m_entries;
+   };
+
+   template <typename M>
+   inline auto make_perfect_hash_map(M const & map)
+      -> CPerfectHashMap<
+            typename std::decay<decltype((*begin(map)).key)>::type,
+            typename std::decay<decltype((*begin(map)).value)>::type>
+   {
+      return CPerfectHashMap<
+         typename std::decay<decltype((*begin(map)).key)>::type,
+         typename std::decay<decltype((*begin(map)).value)>::type>(map);
+   }
+}
+
+#pragma endregion
+
+#pragma region sorted map views
+
+namespace mfc
+{
+   struct key_less
+   {
+      template <typename TPair>
+      bool operator()(TPair const & left, TPair const & right) const
+      {
+         return left.key < right.key;
+      }
+   };
+
+   namespace detail
+   {
+      // maps iterated through POSITION and GetNextAssoc (non-template maps and CTypedPtrMap)
+      template <typename M>
+      struct map_index_traits
+      {
+         typedef typename std::decay<decltype((*begin(std::declval<M const &>())).key)>::type    key_type;
+         typedef typename std::decay<decltype((*begin(std::declval<M const &>())).value)>::type  mapped_type;
+         typedef CMapPair<key_type, mapped_type>   value_type;
+         typedef value_type                        reference;
+         typedef POSITION                          handle_type;
+
+         template <typename Cmp>
+         static void build(M& map, Cmp& cmp, std::vector<handle_type>& index)
+         {
+            std::vector<std::pair<handle_type, value_type>> entries;
+            entries.reserve(static_cast<size_t>(map.GetCount()));
+
+            POSITION pos = map.GetStartPosition();
+            while (pos != nullptr)
+            {
+               POSITION const current = pos;
+               value_type pair;
+               map.GetNextAssoc(pos, pair.key, pair.value);
+               entries.push_back(std::make_pair(current, pair));
+            }
+
+            std::stable_sort(entries.begin(), entries.end(),
+               [&cmp](std::pair<handle_type, value_type> const & left, std::pair<handle_type, value_type> const & right) {
+                  return cmp(left.second, right.second); });
+
+            index.clear();
+            index.reserve(entries.size());
+            for (auto const & entry : entries)
+               index.push_back(entry.first);
+         }
+
+         static reference deref(M& map, handle_type pos)
+         {
+            value_type pair;
+            map.GetNextAssoc(pos, pair.key, pair.value);
+            return pair;
+         }
+      };
+
+      template <typename TPair, typename M>
+      struct map_pair_index_traits
+      {
+         typedef TPair        value_type;
+         typedef TPair&       reference;
+         typedef TPair*       handle_type;
+
+         template <typename Cmp>
+         static void build(M& map, Cmp& cmp, std::vector<handle_type>& index)
+         {
+            index.clear();
+            index.reserve(static_cast<size_t>(map.GetCount()));
+            for (handle_type pair = map.PGetFirstAssoc(); pair != nullptr; pair = map.PGetNextAssoc(pair))
+               index.push_back(pair);
+
+            std::stable_sort(index.begin(), index.end(),
+               [&cmp](handle_type const left, handle_type const right) { return cmp(*left, *right); });
+         }
+
+         static reference deref(M&, handle_type const pair) noexcept
+         {
+            return *pair;
+         }
+      };
+
+      template<typename TKey, typename TKeyArg, typename TValue, typename TValueArg>
+      struct map_index_traits<CMap<TKey, TKeyArg, TValue, TValueArg>> :
+         map_pair_index_traits<
+            typename CMap<TKey, TKeyArg, TValue, TValueArg>::CPair,
+            CMap<TKey, TKeyArg, TValue, TValueArg>>
+      {
+      };
+
+      template<typename TKey, typename TKeyArg, typename TValue, typename TValueArg>
+      struct map_index_traits<CMap<TKey, TKeyArg, TValue, TValueArg> const> :
+         map_pair_index_traits<
+            typename CMap<TKey, TKeyArg, TValue, TValueArg>::CPair const,
+            CMap<TKey, TKeyArg, TValue, TValueArg> const>
+      {
+      };
+   }
+
+   // Iterates a map in comparator order. The order is cached as an index of association pointers
+   // (CMap) or POSITIONs (other maps) and rebuilt only when the map's count or the version token changes.
+   // Removing and adding elements without changing the count must be signalled through the token.
+   template <typename M, typename Cmp = key_less>
+   class CSortedMapView
+   {
+      typedef detail::map_index_traits<M>             traits_type;
+      typedef typename traits_type::handle_type       handle_type;
+
+   public:
+      // Refers to the index by position. The end iterator resolves to the size of the index when it is used,
+      // so it stays consistent with a begin iterator obtained after it, even if begin() rebuilt the index.
+      class iterator
+      {
+      public:
+         typedef iterator                                self_type;
+         typedef typename traits_type::value_type        value_type;
+         typedef typename traits_type::reference         reference;
+         typedef value_type*                             pointer;
+         typedef std::random_access_iterator_tag         iterator_category;
+         typedef ptrdiff_t                               difference_type;
+
+         iterator() = default;
+
+         explicit iterator(M& collection, std::vector<handle_type> const & index, difference_type const pos, bool const end) noexcept :
+            m_pos(pos),
+            m_end(end),
+            m_index(&index),
+            m_collection(&collection)
+         {}
+
+         bool operator== (self_type const & other) const noexcept { return Position() == other.Position(); }
+         bool operator!= (self_type const & other) const noexcept { return Position() != other.Position(); }
+         bool operator< (self_type const & other) const noexcept { return Position() < other.Position(); }
+         bool operator> (self_type const & other) const noexcept { return other.Position() < Position(); }
+         bool operator<= (self_type const & other) const noexcept { return !(other.Position() < Position()); }
+         bool operator>= (self_type const & other) const noexcept { return !(Position() < other.Position()); }
+
+         reference operator* () const
+         {
+            return traits_type::deref(*m_collection, (*m_index)[static_cast<size_t>(Position())]);
+         }
+
+         reference operator[](difference_type const offset) const
+         {
+            return traits_type::deref(*m_collection, (*m_index)[static_cast<size_t>(Position() + offset)]);
+         }
+
+         self_type& operator++ () noexcept { Resolve(); ++m_pos; return *this; }
+         self_type operator++ (int) noexcept { self_type tmp = *this; ++*this; return tmp; }
+         self_type& operator-- () noexcept { Resolve(); --m_pos; return *this; }
+         self_type operator-- (int) noexcept { self_type tmp = *this; --*this; return tmp; }
+         self_type& operator+= (difference_type const offset) noexcept { Resolve(); m_pos += offset; return *this; }
+         self_type& operator-= (difference_type const offset) noexcept { Resolve(); m_pos -= offset; return *this; }
+         self_type operator+ (difference_type const offset) const noexcept { self_type tmp = *this; return tmp += offset; }
+         self_type operator- (difference_type const offset) const noexcept { self_type tmp = *this; return tmp -= offset; }
+         difference_type operator- (self_type const & other) const noexcept { return Position() - other.Position(); }
+
+      private:
+         difference_type Position() const noexcept
+         {
+            return m_end ? static_cast<difference_type>(m_index->size()) : m_pos;
+         }
+
+         void Resolve() noexcept
+         {
+            m_pos = Position();
+            m_end = false;
+         }
+
+         difference_type                     m_pos = 0;
+         bool                                m_end = false;
+         std::vector<handle_type> const *    m_index = nullptr;
+         M*                                  m_collection = nullptr;
+      };
+
+      explicit CSortedMapView(M& collection, Cmp cmp = Cmp(), ULONGLONG const * version = nullptr) :
+         m_collection(collection),
+         m_cmp(cmp),
+         m_version(version)
+      {}
+
+      // the cached order is brought up to date here, once per traversal
+      iterator begin() const
+      {
+         Refresh();
+         return iterator(m_collection, m_index, 0, false);
+      }
+
+      iterator end() const
+      {
+         return iterator(m_collection, m_index, 0, true);
+      }
+
+      INT_PTR GetCount() const
+      {
+         Refresh();
+         return static_cast<INT_PTR>(m_index.size());
+      }
+
+      void Invalidate() noexcept
+      {
+         m_valid = false;
+      }
+
+      // rebuilds the cached order if the map changed; returns true if it did
+      bool Refresh() const
+      {
+         ULONGLONG const version = m_version != nullptr ? *m_version : 0;
+         if (m_valid && m_count == m_collection.GetCount() && m_builtVersion == version)
+            return false;
+
+         traits_type::build(m_collection, m_cmp, m_index);
+         m_count = m_collection.GetCount();
+         m_builtVersion = version;
+         m_valid = true;
+         return true;
+      }
+
+   private:
+      M&                               m_collection;
+      mutable Cmp                      m_cmp;
+      ULONGLONG const *                m_version;
+      mutable std::vector<handle_type> m_index;
+      mutable INT_PTR                  m_count = 0;
+      mutable ULONGLONG                m_builtVersion = 0;
+      mutable bool                     m_valid = false;
+   };
+
+   template <typename M>
+   inline CSortedMapView<M> sorted_view(M& map)
+   {
+      return CSortedMapView<M>(map);
+   }
+
+   template <typename M, typename Cmp>
+   inline CSortedMapView<M, Cmp> sorted_view(M& map, Cmp cmp)
+   {
+      return CSortedMapView<M, Cmp>(map, cmp);
+   }
+
+   template <typename M, typename Cmp>
+   inline CSortedMapView<M, Cmp> sorted_view(M& map, Cmp cmp, ULONGLONG const & version)
+   {
+      return CSortedMapView<M, Cmp>(map, cmp, &version);
+   }
+
+   // the view keeps the address of the version token, so it must not be a temporary
+   template <typename M, typename Cmp>
+   CSortedMapView<M, Cmp> sorted_view(M& map, Cmp cmp, ULONGLONG const && version) = delete;
+}
+
+#pragma endregion
+
+#pragma region executors
+
+namespace mfc
+{
+   // Where the parallel algorithms run their work. Implement Submit and GetConcurrency to route them through
+   // an existing thread pool; Bulk has a default implementation on top of Submit.
+   class CExecutor
+   {
+   public:
+      virtual ~CExecutor() = default;
+
+      // runs task at some point on some thread; the task must not throw
+      virtual void Submit(std::function<void()> task) = 0;
+
+      // number of tasks that can usefully run at the same time
+      virtual INT_PTR GetConcurrency() const noexcept = 0;
+
+      // Runs fn(0) .. fn(count - 1) and returns when all calls have finished. The calling thread takes part,
+      // so Bulk may be called from a task of the same executor. The first exception is rethrown; calls that
+      // had not started by then are skipped.
+      virtual void Bulk(INT_PTR const count, std::function<void(INT_PTR)> const & fn)
+      {
+         INT_PTR const workers = (std::min)(count, GetConcurrency());
+         if (workers <= 1)
+         {
+            for (INT_PTR i = 0; i < count; ++i)
+               fn(i);
+            return;
+         }
+
+         auto const state = std::make_shared<bulk_state>(count, fn);
+         for (INT_PTR i = 1; i < workers; ++i)
+            Submit([state]() { state->Work(); });
+         state->Work();
+         state->Wait();
+      }
+
+   private:
+      // shared with the submitted helpers, which may start after Bulk returned; they then find no index left
+      // and do not touch fn
+      struct bulk_state
+      {
+         bulk_state(INT_PTR const count, std::function<void(INT_PTR)> const & fn) :
+            next(0), finished(0), failed(false), count(count), fn(&fn)
+         {
+         }
+
+         void Work()
+         {
+            for (INT_PTR i = next++; i < count; i = next++)
+            {
+               if (!failed)
+               {
+                  try
+                  {
+                     (*fn)(i);
+                  }
+                  catch (...)
+                  {
+                     if (!failed.exchange(true))
+                        error = std::current_exception();
+                  }
+               }
+
+               if (++finished == count)
+               {
+                  std::lock_guard<std::mutex> lock(doneLock);
+                  done.notify_all();
+               }
+            }
+         }
+
+         void Wait()
+         {
+            std::unique_lock<std::mutex> lock(doneLock);
+            done.wait(lock, [this]() { return finished == count; });
+
+            if (error)
+               std::rethrow_exception(error);
+         }
+
+         std::atomic<INT_PTR>                   next;
+         std::atomic<INT_PTR>                   finished;
+         std::atomic<bool>                      failed;
+         std::exception_ptr                     error;
+         std::mutex                             doneLock;
+         std::condition_variable                done;
+         INT_PTR const                          count;
+         std::function<void(INT_PTR)> const *   fn;
+      };
+   };
+
+   // Runs everything on the calling thread, in order. Makes parallel algorithms deterministic in tests.
+   class CSerialExecutor : public CExecutor
+   {
+   public:
+      void Submit(std::function<void()> task) override
+      {
+         task();
+      }
+
+      INT_PTR GetConcurrency() const noexcept override
+      {
+         return 1;
+      }
+   };
+
+   // Work-stealing thread pool. Every worker has a queue of its own: tasks submitted from a worker go to its
+   // queue and are taken newest first, other tasks are spread over the queues, and an idle worker steals the
+   // oldest task of another worker's queue.
+   class CThreadPool : public CExecutor
+   {
+      struct worker_queue
+      {
+         std::mutex                          lock;
+         std::deque<std::function<void()>>   tasks;
+      };
+
+      struct worker_identity
+      {
+         CThreadPool const *  pool;
+         size_t               index;
+      };
+
+   public:
+      // threads defaults to hardware_concurrency
+      explicit CThreadPool(INT_PTR threads = 0) :
+         m_nextQueue(0),
+         m_pending(0),
+         m_stopping(false)
+      {
+         if (threads <= 0)
+            threads = static_cast<INT_PTR>((std::max)(1u, std::thread::hardware_concurrency()));
+
+         for (INT_PTR i = 0; i < threads; ++i)
+            m_queues.emplace_back(new worker_queue());
+
+         m_threads.reserve(static_cast<size_t>(threads));
+         for (INT_PTR i = 0; i < threads; ++i)
+            m_threads.emplace_back([this, i]() { Run(static_cast<size_t>(i)); });
+      }
+
+      CThreadPool(CThreadPool const &) = delete;
+      CThreadPool& operator=(CThreadPool const &) = delete;
+
+      // runs the tasks still queued, then joins the workers
+      ~CThreadPool()
+      {
+         {
+            std::lock_guard<std::mutex> lock(m_idleLock);
+            m_stopping = true;
+         }
+         m_idle.notify_all();
+
+         for (auto& thread : m_threads)
+            thread.join();
+      }
+
+      void Submit(std::function<void()> task) override
+      {
+         worker_identity const & self = Self();
+         size_t const index = self.pool == this ? self.index : m_nextQueue++ % m_queues.size();
+
+         {
+            std::lock_guard<std::mutex> lock(m_queues[index]->lock);
+            m_queues[index]->tasks.push_back(std::move(task));
+         }
+
+         {
+            std::lock_guard<std::mutex> lock(m_idleLock);
+            ++m_pending;
+         }
+         m_idle.notify_one();
+      }
+
+      INT_PTR GetConcurrency() const noexcept override
+      {
+         return static_cast<INT_PTR>(m_threads.size());
+      }
+
+   private:
+      static worker_identity& Self() noexcept
+      {
+         static thread_local worker_identity self = { nullptr, 0 };
+         return self;
+      }
+
+      void Run(size_t const index)
+      {
+         Self().pool = this;
+         Self().index = index;
+
+         for (;;)
+         {
+            std::function<void()> task;
+            if (Take(index, task))
+            {
+               --m_pending;
+               task();
+               continue;
+            }
+
+            std::unique_lock<std::mutex> lock(m_idleLock);
+            m_idle.wait(lock, [this]() { return m_stopping || m_pending > 0; });
+            if (m_stopping && m_pending == 0)
+               return;
+         }
+      }
+
+      bool Take(size_t const index, std::function<void()>& task)
+      {
+         {
+            worker_queue& own = *m_queues[index];
+            std::lock_guard<std::mutex> lock(own.lock);
+            if (!own.tasks.empty())
+            {
+               task = std::move(own.tasks.back());
+               own.tasks.pop_back();
+               return true;
+            }
+         }
+
+         for (size_t i = 1; i < m_queues.size(); ++i)
+         {
+            worker_queue& victim = *m_queues[(index + i) % m_queues.size()];
+            std::lock_guard<std::mutex> lock(victim.lock);
+            if (!victim.tasks.empty())
+            {
+               task = std::move(victim.tasks.front());
+               victim.tasks.pop_front();
+               return true;
+            }
+         }
+
+         return false;
+      }
+
+      std::vector<std::unique_ptr<worker_queue>>   m_queues;
+      std::vector<std::thread>                     m_threads;
+      std::atomic<size_t>                          m_nextQueue;
+
+      std::mutex                                   m_idleLock;
+      std::condition_variable                      m_idle;
+      std::atomic<size_t>                          m_pending;     // tasks queued and not yet taken
+      bool                                         m_stopping;
+   };
+
+   namespace detail
+   {
+      inline std::atomic<CExecutor*>& executor_override() noexcept
+      {
+         static std::atomic<CExecutor*> executor(nullptr);
+         return executor;
+      }
+   }
+
+   // The executor used by parallel algorithms called without one: the executor installed with
+   // set_default_executor, or else a CThreadPool with one thread per core, created on first use.
+   inline CExecutor& default_executor()
+   {
+      if (CExecutor* const executor = detail::executor_override().load())
+         return *executor;
+
+      static CThreadPool pool;
+      return pool;
+   }
+
+   // Installs the executor for parallel algorithms called without one; nullptr restores the built-in pool.
+   // The executor must outlive its use. Returns the executor installed before.
+   inline CExecutor* set_default_executor(CExecutor* const executor) noexcept
+   {
+      return detail::executor_override().exchange(executor);
+   }
+}
+
+#pragma endregion
+
+#pragma region parallel map traversal
+
+namespace mfc
+{
+   namespace detail
+   {
+      // runs fn(0) .. fn(count - 1) on the executor; the first exception is rethrown
+      template <typename F>
+      void run_parallel(CExecutor& executor, INT_PTR const count, F&& fn)
+      {
+         executor.Bulk(count, [&fn](INT_PTR const index) { fn(index); });
+      }
+
+      // exposes the protected bucket array of the non-template maps (and CTypedPtrMap over them)
+      template <typename M>
+      struct map_buckets : M
+      {
+         typedef typename std::remove_const<M>::type  map_type;
+         typedef POSITION                             handle_type;
+
+         // first association in the buckets [first, last), or nullptr
+         static handle_type first_in(map_type const & map, UINT first, UINT const last) noexcept
+         {
+            auto const table = map.*(&map_buckets::m_pHashTable);
+            if (table == nullptr)
+               return nullptr;
+
+            for (; first < last; ++first)
+               if (table[first] != nullptr)
+                  return reinterpret_cast<POSITION>(table[first]);
+
+            return nullptr;
+         }
+
+         template <typename F>
+         static void walk(M& map, F& fn, handle_type pos, handle_type const stop)
+         {
+            typedef map_index_traits<M> traits_type;
+
+            while (pos != stop)
+            {
+               typename traits_type::value_type pair;
+               map.GetNextAssoc(pos, pair.key, pair.value);
+               fn(pair);
+            }
+         }
+      };
+
+      // exposes the protected bucket array of CMap
+      template <typename TMap, typename TPair>
+      struct cmap_buckets : TMap
+      {
+         typedef TPair* handle_type;
+
+         static handle_type first_in(TMap const & map, UINT first, UINT const last) noexcept
+         {
+            auto const table = map.*(&cmap_buckets::m_pHashTable);
+            if (table == nullptr)
+               return nullptr;
+
+            for (; first < last; ++first)
+               if (table[first] != nullptr)
+                  return table[first];
+
+            return nullptr;
+         }
+
+         template <typename TCollection, typename F>
+         static void walk(TCollection& map, F& fn, handle_type pos, handle_type const stop)
+         {
+            for (; pos != stop; pos = map.PGetNextAssoc(pos))
+               fn(*pos);
+         }
+      };
+
+      template<typename TKey, typename TKeyArg, typename TValue, typename TValueArg>
+      struct map_buckets<CMap<TKey, TKeyArg, TValue, TValueArg>> :
+         cmap_buckets<CMap<TKey, TKeyArg, TValue, TValueArg>, typename CMap<TKey, TKeyArg, TValue, TValueArg>::CPair>
+      {
+      };
+
+      template<typename TKey, typename TKeyArg, typename TValue, typename TValueArg>
+      struct map_buckets<CMap<TKey, TKeyArg, TValue, TValueArg> const> :
+         cmap_buckets<CMap<TKey, TKeyArg, TValue, TValueArg>, typename CMap<TKey, TKeyArg, TValue, TValueArg>::CPair const>
+      {
+      };
+
+      // number of bucket ranges a map is split into for parallel traversal
+      inline INT_PTR bucket_ranges(UINT const buckets, INT_PTR const concurrency) noexcept
+      {
+         INT_PTR const ranges = (std::max)(static_cast<INT_PTR>(1), concurrency) * 8;
+         return (std::min)(ranges, static_cast<INT_PTR>(buckets));
+      }
+
+      inline UINT bucket_range_start(INT_PTR const range, INT_PTR const ranges, UINT const buckets) noexcept
+      {
+         return static_cast<UINT>((static_cast<ULONGLONG>(buckets) * range) / ranges);
+      }
+   }
+
+   namespace parallel
+   {
+      // Calls fn for every element of the map, splitting the bucket array into ranges that are walked on
+      // the executor. fn receives the same element type as a range-based for loop over the map and
+      // must be safe to call concurrently. The map must not be modified structurally during the call.
+      template <typename M, typename F>
+      auto for_each(CExecutor& executor, M& map, F fn) -> decltype(map.GetHashTableSize(), void())
+      {
+         typedef detail::map_buckets<M>               buckets_type;
+         typedef typename buckets_type::handle_type   handle_type;
+
+         if (map.GetCount() == 0)
+            return;
+
+         UINT const buckets = map.GetHashTableSize();
+         INT_PTR const ranges = detail::bucket_ranges(buckets, executor.GetConcurrency());
+
+         // a range's chains run up to the first association of the next non-empty range;
+         // the starts are found in parallel so each thread only scans its own slice of the bucket array
+         std::vector<handle_type> starts(static_cast<size_t>(ranges + 1), nullptr);
+         detail::run_parallel(executor, ranges, [&](INT_PTR const range) {
+            starts[range] = const_cast<handle_type>(buckets_type::first_in(map,
+               detail::bucket_range_start(range, ranges, buckets),
+               detail::bucket_range_start(range + 1, ranges, buckets)));
+         });
+
+         for (INT_PTR range = ranges - 1; range >= 0; --range)
+            if (starts[range] == nullptr)
+               starts[range] = starts[range + 1];
+
+         detail::run_parallel(executor, ranges, [&](INT_PTR const range) {
+            buckets_type::walk(map, fn, starts[range], starts[range + 1]);
+         });
+      }
+
+      // runs on the default executor
+      template <typename M, typename F>
+      auto for_each(M& map, F fn) -> decltype(map.GetHashTableSize(), void())
+      {
+         for_each(default_executor(), map, std::move(fn));
+      }
+   }
+}
+
+#pragma endregion
+
+#pragma region parallel group reduce
+
+namespace mfc
+{
+   namespace detail
+   {
+      template <typename...>
+      struct make_void { typedef void type; };
+
+      template <typename I, typename = void>
+      struct is_random_access : std::false_type {};
+
+      template <typename I>
+      struct is_random_access<I, typename make_void<typename I::iterator_category>::type> :
+         std::is_same<typename I::iterator_category, std::random_access_iterator_tag> {};
+
+      inline INT_PTR worker_count() noexcept
+      {
+         return static_cast<INT_PTR>((std::max)(1u, std::thread::hardware_concurrency()));
+      }
+
+      // a prime about 20% larger than the expected number of elements, as recommended for CMap::InitHashTable
+      inline UINT hash_table_size(INT_PTR const count) noexcept
+      {
+         ULONGLONG candidate = (std::max)(static_cast<ULONGLONG>(17), static_cast<ULONGLONG>(count) + static_cast<ULONGLONG>(count) / 5) | 1;
+         for (;; candidate += 2)
+         {
+            bool prime = true;
+            for (ULONGLONG d = 3; d * d <= candidate && prime; d += 2)
+               prime = (candidate % d) != 0;
+            if (prime || candidate >= 0xFFFFFFFBULL)
+               return static_cast<UINT>(candidate);
+         }
+      }
+
+      // splits the range of a collection into 'chunks' consecutive pieces; each piece is a start iterator and a length
+      template <typename I>
+      struct range_chunk
+      {
+         I        first;
+         INT_PTR  count;
+      };
+
+      template <typename C, typename I>
+      std::vector<range_chunk<I>> split_range(C& collection, I first, INT_PTR const count, INT_PTR const chunks, std::true_type)
+      {
+         std::vector<range_chunk<I>> result;
+         result.reserve(static_cast<size_t>(chunks));
+         for (INT_PTR i = 0; i < chunks; ++i)
+         {
+            INT_PTR const from = count * i / chunks;
+            INT_PTR const to = count * (i + 1) / chunks;
+            result.push_back(range_chunk<I>{ first + from, to - from });
+         }
+         return result;
+      }
+
+      template <typename C, typename I>
+      std::vector<range_chunk<I>> split_range(C&, I first, INT_PTR const count, INT_PTR const chunks, std::false_type)
+      {
+         std::vector<range_chunk<I>> result;
+         result.reserve(static_cast<size_t>(chunks));
+         INT_PTR position = 0;
+         for (INT_PTR i = 0; i < chunks; ++i)
+         {
+            INT_PTR const to = count * (i + 1) / chunks;
+            result.push_back(range_chunk<I>{ first, to - position });
+            for (; position < to; ++position)
+               ++first;
+         }
+         return result;
+      }
+
+      template <typename C>
+      auto split_range(C& collection, INT_PTR const chunks) -> std::vector<range_chunk<decltype(begin(collection))>>
+      {
+         typedef decltype(begin(collection)) iterator_type;
+         INT_PTR const count = static_cast<INT_PTR>(collection.GetCount());
+         return split_range(collection, begin(collection), count, (std::max)(static_cast<INT_PTR>(1), (std::min)(chunks, count)),
+            typename is_random_access<iterator_type>::type());
+      }
+
+      template <typename TMap, typename TKey, typename TValue, typename ReduceFn>
+      void accumulate(TMap& map, TKey const & key, TValue const & value, ReduceFn& reduce_fn)
+      {
+         auto pair = map.PLookup(key);
+         if (pair == nullptr)
+            map.SetAt(key, value);
+         else
+            pair->value = reduce_fn(pair->value, value);
+      }
+   }
+
+   // Groups the elements of a collection by key_fn(element) and folds value_fn(element) into the output map
+   // with reduce_fn(accumulated, value). Each thread accumulates into a partial map of its own; the partials
+   // are then merged into out_map, which is pre-sized with InitHashTable when it is empty. hash_size sets
+   // the bucket count of the partial maps; by default each partial map is sized for the number of elements
+   // in its chunk, the most keys it can receive.
+   template <typename C, typename KeyFn, typename ValueFn, typename ReduceFn,
+             typename TKey, typename TKeyArg, typename TValue, typename TValueArg>
+   void group_reduce(
+      CExecutor& executor,
+      C& collection,
+      KeyFn key_fn,
+      ValueFn value_fn,
+      ReduceFn reduce_fn,
+      CMap<TKey, TKeyArg, TValue, TValueArg>& out_map,
+      UINT const hash_size = 0)
+   {
+      typedef CMap<TKey, TKeyArg, TValue, TValueArg> map_type;
+
+      auto chunks = detail::split_range(collection, executor.GetConcurrency());
+      std::vector<std::unique_ptr<map_type>> partials(chunks.size());
+
+      detail::run_parallel(executor, static_cast<INT_PTR>(chunks.size()), [&](INT_PTR const index) {
+         std::unique_ptr<map_type> partial(new map_type());
+         partial->InitHashTable(hash_size != 0 ? hash_size : detail::hash_table_size(chunks[index].count));
+
+         auto it = chunks[index].first;
+         for (INT_PTR i = 0; i < chunks[index].count; ++i, ++it)
+         {
+            auto && element = *it;
+            detail::accumulate(*partial, key_fn(element), value_fn(element), reduce_fn);
+         }
+
+         partials[index] = std::move(partial);
+      });
+
+      if (out_map.IsEmpty())
+      {
+         INT_PTR largest = 0;
+         for (auto const & partial : partials)
+            largest = (std::max)(largest, static_cast<INT_PTR>(partial->GetCount()));
+
+         UINT const size = detail::hash_table_size(largest);
+         if (size > out_map.GetHashTableSize())
+            out_map.InitHashTable(size);
+      }
+
+      for (auto const & partial : partials)
+      {
+         map_type const & source = *partial;
+         for (auto const & pair : source)
+            detail::accumulate(out_map, pair.key, pair.value, reduce_fn);
+      }
+   }
+
+   // runs on the default executor
+   template <typename C, typename KeyFn, typename ValueFn, typename ReduceFn,
+             typename TKey, typename TKeyArg, typename TValue, typename TValueArg>
+   void group_reduce(
+      C& collection,
+      KeyFn key_fn,
+      ValueFn value_fn,
+      ReduceFn reduce_fn,
+      CMap<TKey, TKeyArg, TValue, TValueArg>& out_map,
+      UINT const hash_size = 0)
+   {
+      group_reduce(default_executor(), collection, std::move(key_fn), std::move(value_fn), std::move(reduce_fn), out_map, hash_size);
+   }
+}
+
+#pragma endregion
+
+#pragma region parallel list traversal
+
+namespace mfc
+{
+   // Every k-th POSITION of a list, found in one sequential pass. The positions split the list into segments
+   // that can be walked independently, so a list can be traversed in parallel with O(n/k) extra memory.
+   // The table is rebuilt by the parallel traversal when the list's count or either end changes, or when an
+   // optional version token supplied by the caller changes. Inserting and removing elements without changing
+   // those must be signalled through the token; without one, call Build again or Invalidate.
+   template <typename L>
+   class CListSkipTable
+   {
+   public:
+      explicit CListSkipTable(ULONGLONG const * version = nullptr) noexcept :
+         m_count(-1), m_head(nullptr), m_tail(nullptr), m_stride(0), m_version(version), m_builtVersion(0)
+      {
+      }
+
+      // stride 0 picks a stride that gives each of the concurrency workers about 16 segments, but no fewer than
+      // 64 elements each; concurrency 0 is that of default_executor()
+      void Build(L const & list, INT_PTR stride = 0, INT_PTR concurrency = 0)
+      {
+         INT_PTR const count = static_cast<INT_PTR>(list.GetCount());
+         if (stride <= 0)
+         {
+            if (concurrency <= 0)
+               concurrency = default_executor().GetConcurrency();
+            stride = (std::max)(static_cast<INT_PTR>(64), count / ((std::max)(concurrency, static_cast<INT_PTR>(1)) * 16));
+         }
+
+         m_starts.clear();
+         m_starts.reserve(static_cast<size_t>(count / stride + 2));
+
+         POSITION pos = list.GetHeadPosition();
+         for (INT_PTR index = 0; pos != nullptr; ++index)
+         {
+            if (index % stride == 0)
+               m_starts.push_back(pos);
+            list.GetNext(pos);
+         }
+         m_starts.push_back(nullptr);
+
+         m_count = count;
+         m_head = list.GetHeadPosition();
+         m_tail = list.GetTailPosition();
+         m_stride = stride;
+         m_builtVersion = Version();
+      }
+
+      // the count, the ends of the list and the version token are the ones the table was built for
+      BOOL IsCurrent(L const & list) const noexcept
+      {
+         return m_count == static_cast<INT_PTR>(list.GetCount()) && m_head == list.GetHeadPosition() &&
+            m_tail == list.GetTailPosition() && m_builtVersion == Version();
+      }
+
+      void Invalidate() noexcept
+      {
+         m_count = -1;
+      }
+
+      INT_PTR GetStride() const noexcept { return m_stride; }
+      INT_PTR GetSegmentCount() const noexcept { return m_starts.empty() ? 0 : static_cast<INT_PTR>(m_starts.size()) - 1; }
+
+      // the segment runs from its start up to the start of the next segment (nullptr after the last one)
+      POSITION GetSegmentStart(INT_PTR const segment) const
+      {
+         ASSERT(segment >= 0 && segment <= GetSegmentCount());
+         return m_starts[static_cast<size_t>(segment)];
+      }
+
+   private:
+      ULONGLONG Version() const noexcept
+      {
+         return m_version != nullptr ? *m_version : 0;
+      }
+
+      std::vector<POSITION>   m_starts;
+      INT_PTR                 m_count;
+      POSITION                m_head;
+      POSITION                m_tail;
+      INT_PTR                 m_stride;
+      ULONGLONG const *       m_version;
+      ULONGLONG               m_builtVersion;
+   };
+
+   namespace parallel
+   {
+      // Calls fn for every element of a CList, CTypedPtrList, CPtrList, CObList or CStringList. The segments
+      // of the skip table are handed to the executor's workers one at a time, so a worker that finishes early
+      // takes the next segment. The table is rebuilt first if it is not current. fn receives the element as
+      // GetNext returns it and must be safe to call concurrently. The list must not be modified during the call.
+      template <typename L, typename F>
+      auto for_each(CExecutor& executor, L& list, CListSkipTable<typename std::remove_const<L>::type>& table, F fn) -> decltype(list.GetHeadPosition(), void())
+      {
+         if (!table.IsCurrent(list))
+            table.Build(list, 0, executor.GetConcurrency());
+
+         detail::run_parallel(executor, table.GetSegmentCount(), [&](INT_PTR const segment) {
+            POSITION const stop = table.GetSegmentStart(segment + 1);
+            for (POSITION pos = table.GetSegmentStart(segment); pos != stop;)
+               fn(list.GetNext(pos));
+         });
+      }
+
+      // builds a skip table for this call
+      template <typename L, typename F>
+      auto for_each(CExecutor& executor, L& list, F fn) -> decltype(list.GetHeadPosition(), void())
+      {
+         CListSkipTable<typename std::remove_const<L>::type> table;
+         table.Build(list, 0, executor.GetConcurrency());
+         for_each(executor, list, table, std::move(fn));
+      }
+
+      // runs on the default executor
+      template <typename L, typename F>
+      auto for_each(L& list, CListSkipTable<typename std::remove_const<L>::type>& table, F fn) -> decltype(list.GetHeadPosition(), void())
+      {
+         for_each(default_executor(), list, table, std::move(fn));
+      }
+
+      template <typename L, typename F>
+      auto for_each(L& list, F fn) -> decltype(list.GetHeadPosition(), void())
+      {
+         for_each(default_executor(), list, std::move(fn));
+      }
+   }
+}
+
+#pragma endregion
+
+#pragma region resumable cursors
+
+namespace mfc
+{
+   enum class cursor_status
+   {
+      suspended,     // the budget ran out; the next run_for call resumes after the last visited element
+      completed,     // all elements were visited
+      modified       // the collection changed between slices and the policy is on_modified::stop
+   };
+
+   enum class on_modified
+   {
+      restart,       // start over from the first element
+      stop           // report cursor_status::modified until Reset() is called
+   };
+
+   namespace detail
+   {
+      template <typename C, typename = void>
+      struct has_pget_first_assoc : std::false_type {};
+
+      template <typename C>
+      struct has_pget_first_assoc<C, typename make_void<decltype(std::declval<C&>().PGetFirstAssoc())>::type> : std::true_type {};
+
+      template <typename C, typename = void>
+      struct has_start_position : std::false_type {};
+
+      template <typename C>
+      struct has_start_position<C, typename make_void<decltype(std::declval<C&>().GetStartPosition())>::type> : std::true_type {};
+
+      template <typename C, typename = void>
+      struct has_head_position : std::false_type {};
+
+      template <typename C>
+      struct has_head_position<C, typename make_void<decltype(std::declval<C&>().GetHeadPosition())>::type> : std::true_type {};
+
+      // what a cursor remembers about a collection to notice that it changed between slices
+      struct collection_state
+      {
+         INT_PTR        count;
+         void const *   first;
+         void const *   last;
+
+         bool operator==(collection_state const & other) const noexcept
+         {
+            return count == other.count && first == other.first && last == other.last;
+         }
+      };
+
+      template <typename C>
+      struct array_cursor_traits
+      {
+         typedef INT_PTR handle_type;
+
+         static handle_type first(C&) noexcept { return 0; }
+         static bool at_end(C& collection, handle_type const index) { return index >= collection.GetSize(); }
+
+         template <typename F>
+         static void visit_next(C& collection, handle_type& index, F& fn)
+         {
+            fn(collection[index]);
+            ++index;
+         }
+
+         static collection_state state(C& collection)
+         {
+            return collection_state{ collection.GetSize(), collection.GetData(), nullptr };
+         }
+      };
+
+      template <typename C>
+      struct list_cursor_traits
+      {
+         typedef POSITION handle_type;
+
+         static handle_type first(C& collection) { return collection.GetHeadPosition(); }
+         static bool at_end(C&, handle_type const pos) noexcept { return pos == nullptr; }
+
+         template <typename F>
+         static void visit_next(C& collection, handle_type& pos, F& fn)
+         {
+            fn(collection.GetNext(pos));
+         }
+
+         static collection_state state(C& collection)
+         {
+            return collection_state{ collection.GetCount(), collection.GetHeadPosition(), collection.GetTailPosition() };
+         }
+      };
+
+      template <typename C>
+      struct cmap_cursor_traits
+      {
+         typedef decltype(std::declval<C&>().PGetFirstAssoc()) handle_type;
+
+         static handle_type first(C& collection) { return collection.PGetFirstAssoc(); }
+         static bool at_end(C&, handle_type const pair) noexcept { return pair == nullptr; }
+
+         template <typename F>
+         static void visit_next(C& collection, handle_type& pair, F& fn)
+         {
+            handle_type const current = pair;
+            pair = collection.PGetNextAssoc(current);
+            fn(*current);
+         }
+
+         static collection_state state(C& collection)
+         {
+            return collection_state{ collection.GetCount(), collection.PGetFirstAssoc(), reinterpret_cast<void const *>(static_cast<UINT_PTR>(collection.GetHashTableSize())) };
+         }
+      };
+
+      template <typename C>
+      struct position_map_cursor_traits
+      {
+         typedef POSITION handle_type;
+
+         static handle_type first(C& collection) { return collection.GetStartPosition(); }
+         static bool at_end(C&, handle_type const pos) noexcept { return pos == nullptr; }
+
+         template <typename F>
+         static void visit_next(C& collection, handle_type& pos, F& fn)
+         {
+            typename map_index_traits<C>::value_type pair;
+            collection.GetNextAssoc(pos, pair.key, pair.value);
+            fn(pair);
+         }
+
+         static collection_state state(C& collection)
+         {
+            return collection_state{ collection.GetCount(), nullptr, reinterpret_cast<void const *>(static_cast<UINT_PTR>(collection.GetHashTableSize())) };
+         }
+      };
+
+      template <typename C>
+      struct cursor_traits :
+         std::conditional<has_pget_first_assoc<C>::value, cmap_cursor_traits<C>,
+         typename std::conditional<has_start_position<C>::value, position_map_cursor_traits<C>,
+         typename std::conditional<has_head_position<C>::value, list_cursor_traits<C>,
+         array_cursor_traits<C>>::type>::type>::type
+      {
+      };
+   }
+
+   // Walks a collection in slices, e.g. from CWinApp::OnIdle. run_for visits elements until the element or
+   // time budget is used up, remembers where it stopped and continues from there on the next call.
+   // Between slices the cursor compares the element count (plus the buffer of arrays, the ends of lists and
+   // the hash table size of maps) and the optional version token with what it saw last; a difference is
+   // handled according to the on_modified policy. Changes that none of these reveal, such as removing and
+   // adding a map element, must be signalled by bumping the version token.
+   template <typename C>
+   class CResumableCursor
+   {
+      typedef detail::cursor_traits<C>          traits_type;
+      typedef typename traits_type::handle_type handle_type;
+
+   public:
+      explicit CResumableCursor(C& collection, on_modified const policy = on_modified::restart, ULONGLONG const * version = nullptr) :
+         m_collection(collection),
+         m_policy(policy),
+         m_version(version)
+      {
+         Reset();
+      }
+
+      void Reset()
+      {
+         m_pos = traits_type::first(m_collection);
+         m_state = traits_type::state(m_collection);
+         m_builtVersion = CurrentVersion();
+         m_processed = 0;
+         m_modified = false;
+      }
+
+      bool IsComplete() const
+      {
+         return !m_modified && traits_type::at_end(m_collection, m_pos);
+      }
+
+      // number of elements visited since the last (re)start
+      INT_PTR GetProcessed() const noexcept
+      {
+         return m_processed;
+      }
+
+      template <typename F>
+      cursor_status run_for(INT_PTR const max_elements, F fn)
+      {
+         return Run(max_elements, nullptr, fn);
+      }
+
+      template <typename Rep, typename Period, typename F>
+      cursor_status run_for(std::chrono::duration<Rep, Period> const budget, F fn)
+      {
+         auto const deadline = std::chrono::steady_clock::now() + budget;
+         return Run(-1, &deadline, fn);
+      }
+
+      template <typename Rep, typename Period, typename F>
+      cursor_status run_for(INT_PTR const max_elements, std::chrono::duration<Rep, Period> const budget, F fn)
+      {
+         auto const deadline = std::chrono::steady_clock::now() + budget;
+         return Run(max_elements, &deadline, fn);
+      }
+
+   private:
+      enum : INT_PTR { ClockInterval = 16 };
+
+      ULONGLONG CurrentVersion() const noexcept
+      {
+         return m_version != nullptr ? *m_version : 0;
+      }
+
+      bool Modified() const
+      {
+         return !(traits_type::state(m_collection) == m_state) || CurrentVersion() != m_builtVersion;
+      }
+
+      template <typename F>
+      cursor_status Run(INT_PTR const max_elements, std::chrono::steady_clock::time_point const * deadline, F& fn)
+      {
+         if (m_modified || Modified())
+         {
+            if (m_policy == on_modified::stop)
+            {
+               m_modified = true;
+               return cursor_status::modified;
+            }
+
+            Reset();
+         }
+
+         for (INT_PTR visited = 0; !traits_type::at_end(m_collection, m_pos); )
+         {
+            if (max_elements >= 0 && visited >= max_elements)
+               return cursor_status::suspended;
+
+            if (deadline != nullptr && visited % ClockInterval == 0 && visited > 0 &&
+               std::chrono::steady_clock::now() >= *deadline)
+               return cursor_status::suspended;
+
+            traits_type::visit_next(m_collection, m_pos, fn);
+            ++visited;
+            ++m_processed;
+         }
+
+         return cursor_status::completed;
+      }
+
+      C&                m_collection;
+      on_modified       m_policy;
+      ULONGLONG const * m_version;
+      handle_type       m_pos;
+      detail::collection_state m_state;
+      ULONGLONG         m_builtVersion = 0;
+      INT_PTR           m_processed = 0;
+      bool              m_modified = false;
+   };
+
+   template <typename C>
+   inline CResumableCursor<C> make_cursor(C& collection, on_modified const policy = on_modified::restart)
+   {
+      return CResumableCursor<C>(collection, policy);
+   }
+
+   template <typename C>
+   inline CResumableCursor<C> make_cursor(C& collection, on_modified const policy, ULONGLONG const & version)
+   {
+      return CResumableCursor<C>(collection, policy, &version);
+   }
+
+   // the cursor keeps the address of the version token, so it must not be a temporary
+   template <typename C>
+   CResumableCursor<C> make_cursor(C& collection, on_modified const policy, ULONGLONG const && version) = delete;
+}
+
+#pragma endregion
+
+#pragma region bulk array serialization
+
+namespace mfc
+{
+   namespace detail
+   {
+      constexpr DWORD fourcc(char const a, char const b, char const c, char const d) noexcept
+      {
+         return static_cast<DWORD>(static_cast<BYTE>(a)) | (static_cast<DWORD>(static_cast<BYTE>(b)) << 8) |
+            (static_cast<DWORD>(static_cast<BYTE>(c)) << 16) | (static_cast<DWORD>(static_cast<BYTE>(d)) << 24);
+      }
+   }
+
+   // Identifies the element type in a blob header; specialize for your own types to have it checked on load.
+   // Types without a tag (0) are only checked by element size.
+   template <typename T> struct blob_type_tag { enum : DWORD { value = 0 }; };
+   template <> struct blob_type_tag<char> { enum : DWORD { value = detail::fourcc('C', 'H', 'A', 'R') }; };
+   template <> struct blob_type_tag<signed char> { enum : DWORD { value = detail::fourcc('S', 'C', 'H', 'R') }; };
+   template <> struct blob_type_tag<BYTE> { enum : DWORD { value = detail::fourcc('B', 'Y', 'T', 'E') }; };
+   template <> struct blob_type_tag<short> { enum : DWORD { value = detail::fourcc('S', 'H', 'R', 'T') }; };
+   template <> struct blob_type_tag<WORD> { enum : DWORD { value = detail::fourcc('W', 'O', 'R', 'D') }; };
+   template <> struct blob_type_tag<int> { enum : DWORD { value = detail::fourcc('I', 'N', 'T', ' ') }; };
+   template <> struct blob_type_tag<UINT> { enum : DWORD { value = detail::fourcc('U', 'I', 'N', 'T') }; };
+   template <> struct blob_type_tag<long> { enum : DWORD { value = detail::fourcc('L', 'O', 'N', 'G') }; };
+   template <> struct blob_type_tag<DWORD> { enum : DWORD { value = detail::fourcc('D', 'W', 'R', 'D') }; };
+   template <> struct blob_type_tag<LONGLONG> { enum : DWORD { value = detail::fourcc('I', '6', '4', ' ') }; };
+   template <> struct blob_type_tag<ULONGLONG> { enum : DWORD { value = detail::fourcc('U', '6', '4', ' ') }; };
+   template <> struct blob_type_tag<float> { enum : DWORD { value = detail::fourcc('F', 'L', 'T', ' ') }; };
+   template <> struct blob_type_tag<double> { enum : DWORD { value = detail::fourcc('D', 'B', 'L', ' ') }; };
+   template <> struct blob_type_tag<POINT> { enum : DWORD { value = detail::fourcc('P', 'N', 'T', ' ') }; };
+
+   namespace detail
+   {
+      struct blob_header
+      {
+         enum : DWORD { Signature = fourcc('M', 'F', 'C', 'B') };
+         enum : WORD { Version = 1 };
+         enum : BYTE { LittleEndian = 1, BigEndian = 2 };
+
+         DWORD       signature;
+         WORD        version;
+         BYTE        endianness;
+         BYTE        reserved;
+         DWORD       type_tag;
+         DWORD       element_size;
+         ULONGLONG   count;
+      };
+
+      static_assert(sizeof(blob_header) == 24, "blob_header must not contain padding");
+
+      inline BYTE native_endianness() noexcept
+      {
+         WORD const probe = 1;
+         return *reinterpret_cast<BYTE const *>(&probe) == 1 ? blob_header::LittleEndian : blob_header::BigEndian;
+      }
+
+      template <typename T>
+      inline void byte_swap(T* data, INT_PTR const count) noexcept
+      {
+         for (INT_PTR i = 0; i < count; ++i)
+         {
+            BYTE* bytes = reinterpret_cast<BYTE*>(data + i);
+            std::reverse(bytes, bytes + sizeof(T));
+         }
+      }
+
+      // The header is always stored little-endian, so a reader on any platform can check the signature and
+      // learn the byte order of the elements that follow. Converts in both directions.
+      inline blob_header fixed_order(blob_header header) noexcept
+      {
+         if (native_endianness() != blob_header::LittleEndian)
+         {
+            byte_swap(&header.signature, 1);
+            byte_swap(&header.version, 1);
+            byte_swap(&header.type_tag, 1);
+            byte_swap(&header.element_size, 1);
+            byte_swap(&header.count, 1);
+         }
+         return header;
+      }
+
+      // CArchive::Write/Read and CFile::Write/Read take UINT sizes; larger buffers are transferred in 1 GB pieces
+      enum : ULONGLONG { MaxTransfer = 0x40000000 };
+
+      template <typename S>
+      void write_bytes(S& stream, void const * data, ULONGLONG size)
+      {
+         BYTE const * bytes = static_cast<BYTE const *>(data);
+         while (size > 0)
+         {
+            UINT const chunk = static_cast<UINT>((std::min)(size, static_cast<ULONGLONG>(MaxTransfer)));
+            stream.Write(bytes, chunk);
+            bytes += chunk;
+            size -= chunk;
+         }
+      }
+
+      template <typename S>
+      void read_bytes(S& stream, void* data, ULONGLONG size)
+      {
+         BYTE* bytes = static_cast<BYTE*>(data);
+         while (size > 0)
+         {
+            UINT const chunk = static_cast<UINT>((std::min)(size, static_cast<ULONGLONG>(MaxTransfer)));
+            if (stream.Read(bytes, chunk) != chunk)
+               AfxThrowArchiveException(CArchiveException::endOfFile);
+            bytes += chunk;
+            size -= chunk;
+         }
+      }
+
+      template <typename C>
+      struct blob_element
+      {
+         typedef typename std::remove_const<typename std::remove_pointer<decltype(std::declval<C&>().GetData())>::type>::type type;
+      };
+   }
+
+   // Writes an array of trivially copyable elements (CArray<T> or CByteArray, CWordArray, CDWordArray, CUIntArray)
+   // to a CArchive or CFile as a small header followed by the raw element buffer.
+   template <typename S, typename C>
+   void write_blob(S& stream, C const & collection)
+   {
+      typedef typename detail::blob_element<C>::type element_type;
+      static_assert(std::is_trivially_copyable<element_type>::value, "write_blob requires trivially copyable elements");
+
+      detail::blob_header header = {};
+      header.signature = detail::blob_header::Signature;
+      header.version = detail::blob_header::Version;
+      header.endianness = detail::native_endianness();
+      header.type_tag = blob_type_tag<element_type>::value;
+      header.element_size = sizeof(element_type);
+      header.count = static_cast<ULONGLONG>(collection.GetSize());
+
+      detail::blob_header const stored = detail::fixed_order(header);
+      stream.Write(&stored, sizeof(stored));
+      if (header.count > 0)
+         detail::write_bytes(stream, collection.GetData(), header.count * sizeof(element_type));
+   }
+
+   // Reads an array written by write_blob with a single SetSize and a read straight into the array's buffer.
+   // Throws a CArchiveException if the header does not match the element type of the array.
+   template <typename S, typename C>
+   void read_blob(S& stream, C& collection)
+   {
+      typedef typename detail::blob_element<C>::type element_type;
+      static_assert(std::is_trivially_copyable<element_type>::value, "read_blob requires trivially copyable elements");
+
+      detail::blob_header header;
+      detail::read_bytes(stream, &header, sizeof(header));
+      header = detail::fixed_order(header);
+
+      if (header.signature != detail::blob_header::Signature ||
+          header.version != detail::blob_header::Version ||
+          header.element_size != sizeof(element_type) ||
+          header.type_tag != static_cast<DWORD>(blob_type_tag<element_type>::value))
+         AfxThrowArchiveException(CArchiveException::badSchema);
+
+      bool const swap = header.endianness != detail::native_endianness();
+      if (swap && !std::is_integral<element_type>::value)
+         AfxThrowArchiveException(CArchiveException::badSchema);
+
+      if (header.count > static_cast<ULONGLONG>((std::numeric_limits<INT_PTR>::max)() / static_cast<INT_PTR>(sizeof(element_type))))
+         AfxThrowArchiveException(CArchiveException::badIndex);
+
+      INT_PTR const count = static_cast<INT_PTR>(header.count);
+      collection.SetSize(count);
+      if (count > 0)
+      {
+         detail::read_bytes(stream, collection.GetData(), header.count * sizeof(element_type));
+         if (swap)
+            detail::byte_swap(collection.GetData(), count);
+      }
+   }
+}
+
+#pragma endregion
+
+#pragma region memory-mapped arrays
+
+namespace mfc
+{
+   // Read-only view of an array file written by write_blob. The file is mapped into memory instead of being
+   // read, so opening it is O(1) and pages are loaded on first access. Iterators are CTypeArrayIterator's,
+   // so the view works with the same random-access algorithms as CArray (std::lower_bound, std::equal_range...).
+   template <typename T>
+   class CMappedArray
+   {
+      static_assert(std::is_trivially_copyable<T>::value, "CMappedArray requires trivially copyable elements");
+      static_assert(sizeof(detail::blob_header) % alignof(T) == 0, "element alignment exceeds the blob header alignment");
+
+   public:
+      typedef CTypeArrayIterator<CMappedArray<T> const, T const> const_iterator;
+
+      CMappedArray() = default;
+
+      explicit CMappedArray(LPCTSTR fileName)
+      {
+         if (!Open(fileName))
+            AfxThrowFileException(CFileException::fileNotFound, -1, fileName);
+      }
+
+      CMappedArray(CMappedArray const &) = delete;
+      CMappedArray& operator=(CMappedArray const &) = delete;
+
+      CMappedArray(CMappedArray&& other) noexcept :
+         m_view(other.m_view),
+         m_data(other.m_data),
+         m_count(other.m_count)
+      {
+         other.m_view = nullptr;
+         other.m_data = nullptr;
+         other.m_count = 0;
+      }
+
+      CMappedArray& operator=(CMappedArray&& other) noexcept
+      {
+         if (this != &other)
+         {
+            Close();
+            std::swap(m_view, other.m_view);
+            std::swap(m_data, other.m_data);
+            std::swap(m_count, other.m_count);
+         }
+         return *this;
+      }
+
+      ~CMappedArray()
+      {
+         Close();
+      }
+
+      // maps the file; returns FALSE if it cannot be mapped or is not a blob of T
+      BOOL Open(LPCTSTR fileName)
+      {
+         Close();
+
+         HANDLE const file = ::CreateFile(fileName, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+            FILE_ATTRIBUTE_NORMAL | FILE_FLAG_RANDOM_ACCESS, nullptr);
+         if (file == INVALID_HANDLE_VALUE)
+            return FALSE;
+
+         LARGE_INTEGER size;
+         HANDLE mapping = nullptr;
+         if (::GetFileSizeEx(file, &size) &&
+             static_cast<ULONGLONG>(size.QuadPart) >= sizeof(detail::blob_header) &&
+             static_cast<ULONGLONG>(size.QuadPart) <= static_cast<ULONGLONG>((std::numeric_limits<SIZE_T>::max)()))
+         {
+            mapping = ::CreateFileMapping(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+         }
+
+         // the view keeps the mapping and the file open
+         ::CloseHandle(file);
+         if (mapping == nullptr)
+            return FALSE;
+
+         void const * const view = ::MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+         ::CloseHandle(mapping);
+         if (view == nullptr)
+            return FALSE;
+
+         m_view = view;
+
+         detail::blob_header const header = detail::fixed_order(*static_cast<detail::blob_header const *>(view));
+         ULONGLONG const available = (static_cast<ULONGLONG>(size.QuadPart) - sizeof(detail::blob_header)) / sizeof(T);
+         if (header.signature != detail::blob_header::Signature ||
+             header.version != detail::blob_header::Version ||
+             header.endianness != detail::native_endianness() ||
+             header.element_size != sizeof(T) ||
+             header.type_tag != static_cast<DWORD>(blob_type_tag<T>::value) ||
+             header.count > available)
+         {
+            Close();
+            return FALSE;
+         }
+
+         m_data = reinterpret_cast<T const *>(static_cast<BYTE const *>(view) + sizeof(detail::blob_header));
+         m_count = static_cast<INT_PTR>(header.count);
+         return TRUE;
+      }
+
+      void Close() noexcept
+      {
+         if (m_view != nullptr)
+            ::UnmapViewOfFile(m_view);
+
+         m_view = nullptr;
+         m_data = nullptr;
+         m_count = 0;
+      }
+
+      bool IsOpen() const noexcept { return m_view != nullptr; }
+
+      INT_PTR GetSize() const noexcept { return m_count; }
+      INT_PTR GetCount() const noexcept { return m_count; }
+      INT_PTR GetUpperBound() const noexcept { return m_count - 1; }
+      BOOL IsEmpty() const noexcept { return m_count == 0; }
+
+      T const * GetData() const noexcept { return m_data; }
+
+      T const & GetAt(INT_PTR const index) const
+      {
+         ASSERT(index >= 0 && index < m_count);
+         return m_data[index];
+      }
+
+      T const & operator[](INT_PTR const index) const
+      {
+         return GetAt(index);
+      }
+
+      const_iterator begin() const noexcept { return const_iterator(*this, 0); }
+      const_iterator end() const noexcept { return const_iterator(*this, m_count); }
+
+   private:
+      void const *   m_view = nullptr;
+      T const *      m_data = nullptr;
+      INT_PTR        m_count = 0;
+   };
+
+   template <typename T>
+   inline typename CMappedArray<T>::const_iterator begin(CMappedArray<T> const & collection) noexcept
+   {
+      return collection.begin();
+   }
+
+   template <typename T>
+   inline typename CMappedArray<T>::const_iterator end(CMappedArray<T> const & collection) noexcept
+   {
+      return collection.end();
+   }
+}
+
+#pragma endregion
+
+#pragma region streaming archive ranges
+
+namespace mfc
+{
+   // Describes how a collection writes its elements in Serialize: the element type and how one element is read back.
+   template <typename C>
+   struct archive_element;
+
+   template <typename T, typename TArg>
+   struct archive_element<CArray<T, TArg>>
+   {
+      typedef T type;
+      static void read(CArchive& ar, T& value) { SerializeElements<T>(ar, &value, 1); }
+   };
+
+   template <typename T, typename TArg>
+   struct archive_element<CList<T, TArg>>
+   {
+      typedef T type;
+      static void read(CArchive& ar, T& value) { SerializeElements<T>(ar, &value, 1); }
+   };
+
+   template <>
+   struct archive_element<CStringArray>
+   {
+      typedef CString type;
+      static void read(CArchive& ar, CString& value) { ar >> value; }
+   };
+
+   template <>
+   struct archive_element<CStringList>
+   {
+      typedef CString type;
+      static void read(CArchive& ar, CString& value) { ar >> value; }
+   };
+
+   template <>
+   struct archive_element<CObArray>
+   {
+      typedef CObject* type;
+      static void read(CArchive& ar, CObject*& value) { ar >> value; }
+   };
+
+   template <>
+   struct archive_element<CObList>
+   {
+      typedef CObject* type;
+      static void read(CArchive& ar, CObject*& value) { ar >> value; }
+   };
+
+   template <typename T>
+   struct archive_element<CTypedPtrArray<CObArray, T>>
+   {
+      typedef T type;
+      static void read(CArchive& ar, T& value)
+      {
+         CObject* object = nullptr;
+         ar >> object;
+         value = static_cast<T>(object);
+      }
+   };
+
+   template <typename T>
+   struct archive_element<CTypedPtrList<CObList, T>>
+   {
+      typedef T type;
+      static void read(CArchive& ar, T& value)
+      {
+         CObject* object = nullptr;
+         ar >> object;
+         value = static_cast<T>(object);
+      }
+   };
+
+   // Input range over the elements a collection of type C wrote with Serialize. Elements are read from the archive
+   // one at a time as the range is advanced, so only the current element is held in memory. Stopping early leaves
+   // the archive positioned after the last element read. Objects read from CObList/CObArray streams are owned by
+   // the caller, as they would be by the list; the archive still records them in its load map.
+   template <typename C>
+   class CArchiveRange
+   {
+   public:
+      typedef typename archive_element<C>::type value_type;
+
+      class iterator
+      {
+      public:
+         typedef std::input_iterator_tag  iterator_category;
+         typedef typename CArchiveRange::value_type value_type;
+         typedef std::ptrdiff_t           difference_type;
+         typedef value_type*              pointer;
+         typedef value_type&              reference;
+
+         iterator() noexcept : m_range(nullptr) {}
+         explicit iterator(CArchiveRange* range) noexcept : m_range(range) {}
+
+         reference operator* () const
+         {
+            ASSERT(m_range != nullptr);
+            return m_range->m_current;
+         }
+
+         pointer operator-> () const
+         {
+            return &**this;
+         }
+
+         iterator& operator++ ()
+         {
+            if (!m_range->Next())
+               m_range = nullptr;
+            return *this;
+         }
+
+         bool operator== (iterator const & other) const noexcept { return m_range == other.m_range; }
+         bool operator!= (iterator const & other) const noexcept { return m_range != other.m_range; }
+
+      private:
+         CArchiveRange* m_range;
+      };
+
+      explicit CArchiveRange(CArchive& ar) :
+         m_archive(&ar),
+         m_count(0),
+         m_remaining(0),
+         m_started(false),
+         m_valid(false),
+         m_current()
+      {
+         ASSERT(ar.IsLoading());
+         m_count = m_remaining = ar.ReadCount();
+      }
+
+      // number of elements recorded in the stream
+      DWORD_PTR GetCount() const noexcept { return m_count; }
+
+      // number of elements not read yet
+      DWORD_PTR GetRemaining() const noexcept { return m_remaining; }
+
+      iterator begin()
+      {
+         if (!m_started)
+         {
+            m_started = true;
+            Next();
+         }
+         return m_valid ? iterator(this) : iterator();
+      }
+
+      iterator end() noexcept
+      {
+         return iterator();
+      }
+
+   private:
+      bool Next()
+      {
+         m_valid = m_remaining > 0;
+         if (m_valid)
+         {
+            archive_element<C>::read(*m_archive, m_current);
+            --m_remaining;
+         }
+         else
+         {
+            m_current = value_type();
+         }
+         return m_valid;
+      }
+
+      CArchive*   m_archive;
+      DWORD_PTR   m_count;
+      DWORD_PTR   m_remaining;
+      bool        m_started;
+      bool        m_valid;
+      value_type  m_current;
+   };
+
+   // Reads the element count of a collection of type C from the archive and returns a lazy range over its elements,
+   // e.g. for (CString const & line : mfc::archive_range<CStringList>(ar)) { ... }
+   template <typename C>
+   inline CArchiveRange<C> archive_range(CArchive& ar)
+   {
+      return CArchiveRange<C>(ar);
+   }
+}
+
+#pragma endregion
+
+#pragma region asynchronous export
+
+namespace mfc
+{
+   UINT const DefaultExportBufferSize = 256 * 1024;
+
+   namespace detail
+   {
+      // elements are written as they are, CMap associations as CMapPair records
+      template <typename E, typename = void>
+      struct export_record
+      {
+         typedef E type;
+         static E const & get(E const & element) noexcept { return element; }
+      };
+
+      template <typename E>
+      struct export_record<E, typename make_void<decltype(std::declval<E const &>().key), decltype(std::declval<E const &>().value)>::type>
+      {
+         typedef CMapPair<
+            typename std::decay<decltype(std::declval<E const &>().key)>::type,
+            typename std::decay<decltype(std::declval<E const &>().value)>::type> type;
+
+         static type get(E const & element)
+         {
+            type record = {};
+            record.key = element.key;
+            record.value = element.value;
+            return record;
+         }
+      };
+
+      template <typename C>
+      struct export_record_of
+      {
+         typedef typename std::decay<decltype(*begin(std::declval<C const &>()))>::type element_type;
+         typedef typename export_record<element_type>::type type;
+      };
+
+      // Buffers filled on the caller's thread and written by tasks of an executor, one buffer at a time and in
+      // order. Written buffers are recycled, so at most MaxBuffers exist. At that limit the caller writes the
+      // oldest buffer itself if no task is writing one, so an export cannot wait on an executor that is busy.
+      class export_writer : public std::enable_shared_from_this<export_writer>
+      {
+      public:
+         typedef std::function<void(std::exception_ptr)> completion_type;
+
+         export_writer(CExecutor& executor, CFile& file, UINT const bufferSize, completion_type completion) :
+            m_executor(executor),
+            m_file(file),
+            m_bufferSize(bufferSize),
+            m_used(0),
+            m_allocated(0),
+            m_scheduled(false),
+            m_writing(false),
+            m_finished(false),
+            m_cancelled(false),
+            m_completion(std::move(completion))
+         {
+         }
+
+         void Append(void const * data, size_t size)
+         {
+            BYTE const * bytes = static_cast<BYTE const *>(data);
+            while (size > 0)
+            {
+               if (!m_current)
+                  m_current = Acquire();
+
+               size_t const chunk = (std::min)(size, static_cast<size_t>(m_bufferSize - m_used));
+               memcpy(m_current.get() + m_used, bytes, chunk);
+               m_used += static_cast<UINT>(chunk);
+               bytes += chunk;
+               size -= chunk;
+
+               if (m_used == m_bufferSize)
+                  Submit();
+            }
+         }
+
+         void Finish()
+         {
+            if (m_used > 0)
+               Submit();
+
+            std::unique_lock<std::mutex> lock(m_lock);
+            m_finished = true;
+            Schedule(lock);
+         }
+
+         // The error goes to the caller, so on_complete is not called. Returns once no buffer is being written;
+         // a task that starts later finds the export cancelled and does not touch the file.
+         void Cancel(std::exception_ptr error)
+         {
+            std::unique_lock<std::mutex> lock(m_lock);
+            m_error = error;
+            m_finished = true;
+            m_cancelled = true;
+            m_returned.wait(lock, [this]() { return !m_writing; });
+         }
+
+      private:
+         struct buffer
+         {
+            std::unique_ptr<BYTE[]>   data;
+            UINT                      size = 0;
+         };
+
+         // executor task: writes the queued buffers, then flushes and completes once the caller has finished
+         void Drain()
+         {
+            std::unique_lock<std::mutex> lock(m_lock);
+            while (!m_writing && !m_full.empty())
+               WriteNext(lock);
+
+            m_scheduled = false;
+            if (!m_finished || m_cancelled || m_writing || !m_full.empty())
+               return;
+
+            std::exception_ptr error = m_error;
+            lock.unlock();
+
+            if (!error)
+            {
+               try
+               {
+                  m_file.Flush();
+               }
+               catch (...)
+               {
+                  error = std::current_exception();
+               }
+            }
+
+            if (m_completion)
+               m_completion(error);
+         }
+
+         void WriteNext(std::unique_lock<std::mutex>& lock)
+         {
+            buffer pending = std::move(m_full.front());
+            m_full.pop_front();
+            m_writing = true;
+            std::exception_ptr error = m_error;
+            lock.unlock();
+
+            // after an error the remaining buffers are only recycled
+            if (!error)
+            {
+               try
+               {
+                  m_file.Write(pending.data.get(), pending.size);
+               }
+               catch (...)
+               {
+                  error = std::current_exception();
+               }
+            }
+
+            lock.lock();
+            m_writing = false;
+            m_free.push_back(std::move(pending.data));
+            if (error && !m_error)
+               m_error = error;
+            m_returned.notify_all();
+         }
+
+         std::unique_ptr<BYTE[]> Acquire()
+         {
+            {
+               std::unique_lock<std::mutex> lock(m_lock);
+               for (;;)
+               {
+                  if (!m_free.empty())
+                  {
+                     std::unique_ptr<BYTE[]> data = std::move(m_free.back());
+                     m_free.pop_back();
+                     return data;
+                  }
+
+                  if (m_allocated < MaxBuffers)
+                     break;
+
+                  if (!m_writing && !m_full.empty())
+                     WriteNext(lock);
+                  else
+                     m_returned.wait(lock);
+               }
+               ++m_allocated;
+            }
+
+            return std::unique_ptr<BYTE[]>(new BYTE[m_bufferSize]);
+         }
+
+         void Submit()
+         {
+            buffer full;
+            full.data = std::move(m_current);
+            full.size = m_used;
+            m_used = 0;
+
+            std::unique_lock<std::mutex> lock(m_lock);
+            m_full.push_back(std::move(full));
+            Schedule(lock);
+         }
+
+         // submits a Drain task unless one is pending; outside the lock, since an executor may run it inline
+         void Schedule(std::unique_lock<std::mutex>& lock)
+         {
+            if (m_scheduled)
+               return;
+
+            m_scheduled = true;
+            lock.unlock();
+
+            std::shared_ptr<export_writer> const self = shared_from_this();
+            m_executor.Submit([self]() { self->Drain(); });
+         }
+
+         // one buffer being filled, one queued and one being written
+         enum : UINT { MaxBuffers = 3 };
+
+         CExecutor&                             m_executor;
+         CFile&                                 m_file;
+         UINT const                             m_bufferSize;
+
+         // caller's thread
+         std::unique_ptr<BYTE[]>                m_current;
+         UINT                                   m_used;
+
+         // shared, guarded by m_lock
+         std::mutex                             m_lock;
+         std::condition_variable                m_returned;
+         std::deque<buffer>                     m_full;
+         std::vector<std::unique_ptr<BYTE[]>>   m_free;
+         UINT                                   m_allocated;
+         bool                                   m_scheduled;   // a Drain task is submitted and has not finished
+         bool                                   m_writing;     // a buffer is being written, by a task or the caller
+         bool                                   m_finished;
+         bool                                   m_cancelled;
+         std::exception_ptr                     m_error;
+
+         completion_type                        m_completion;
+      };
+
+      // arrays are copied straight from their buffer
+      template <typename C>
+      auto export_elements(export_writer& writer, C const & collection, int) -> decltype(collection.GetData(), void())
+      {
+         typedef typename blob_element<C>::type element_type;
+         if (collection.GetSize() > 0)
+            writer.Append(collection.GetData(), static_cast<size_t>(collection.GetSize()) * sizeof(element_type));
+      }
+
+      template <typename C>
+      void export_elements(export_writer& writer, C const & collection, long)
+      {
+         typedef typename export_record_of<C>::element_type element_type;
+         for (auto const & element : collection)
+         {
+            auto const & record = export_record<element_type>::get(element);
+            writer.Append(&record, sizeof(record));
+         }
+      }
+   }
+
+   // Exports an array, list or map of trivially copyable elements to a file in the write_blob format without
+   // blocking on the disk. The elements are copied into fixed-size buffers on the calling thread, so the collection
+   // may be changed as soon as the function returns; tasks submitted to the executor write the buffers and then
+   // call on_complete with the exception that stopped them, if any. At most three buffers exist at a time; once
+   // they are all filled, the calling thread waits for the writing task, or writes a buffer itself if the executor
+   // has not started one. Map elements are written as CMapPair records. The file and the executor must stay alive
+   // until on_complete is called; on_complete runs on an executor task. An exception raised on the calling thread
+   // is thrown to the caller instead, and on_complete is not called.
+   template <typename C>
+   void export_async(
+      CExecutor& executor,
+      CFile& file,
+      C const & collection,
+      std::function<void(std::exception_ptr)> on_complete,
+      UINT const buffer_size = DefaultExportBufferSize)
+   {
+      typedef typename detail::export_record_of<C>::type record_type;
+      static_assert(std::is_trivially_copyable<record_type>::value, "export_async requires trivially copyable elements");
+      ASSERT(buffer_size > 0);
+
+      detail::blob_header header = {};
+      header.signature = detail::blob_header::Signature;
+      header.version = detail::blob_header::Version;
+      header.endianness = detail::native_endianness();
+      header.type_tag = blob_type_tag<record_type>::value;
+      header.element_size = sizeof(record_type);
+      header.count = static_cast<ULONGLONG>(collection.GetCount());
+
+      auto writer = std::make_shared<detail::export_writer>(executor, file, buffer_size, std::move(on_complete));
+
+      try
+      {
+         detail::blob_header const stored = detail::fixed_order(header);
+         writer->Append(&stored, sizeof(stored));
+         detail::export_elements(*writer, collection, 0);
+      }
+      catch (...)
+      {
+         writer->Cancel(std::current_exception());
+         throw;
+      }
+
+      writer->Finish();
+   }
+
+   // Same as above, on default_executor().
+   template <typename C>
+   void export_async(
+      CFile& file,
+      C const & collection,
+      std::function<void(std::exception_ptr)> on_complete,
+      UINT const buffer_size = DefaultExportBufferSize)
+   {
+      export_async(default_executor(), file, collection, std::move(on_complete), buffer_size);
+   }
+
+   // Same as above, with completion reported through the returned future.
+   template <typename C>
+   std::future<void> export_async(
+      CExecutor& executor,
+      CFile& file,
+      C const & collection,
+      UINT const buffer_size = DefaultExportBufferSize)
+   {
+      auto promise = std::make_shared<std::promise<void>>();
+      std::future<void> result = promise->get_future();
+
+      export_async(executor, file, collection, [promise](std::exception_ptr error) {
+         if (error)
+            promise->set_exception(error);
+         else
+            promise->set_value();
+      }, buffer_size);
+
+      return result;
+   }
+
+   template <typename C>
+   std::future<void> export_async(CFile& file, C const & collection, UINT const buffer_size = DefaultExportBufferSize)
+   {
+      return export_async(default_executor(), file, collection, buffer_size);
+   }
+}
+
+#pragma endregion
+
+#pragma region pooled string arrays
+
+namespace mfc
+{
+   // Append-only array of strings that stores all characters, each string followed by a terminating null,
+   // in a single buffer and the position of every string in an offsets table. Compared to CStringArray
+   // there is no allocation and no CStringData header per element, and consecutive strings are adjacent in memory.
+   class CPooledStringArray
+   {
+   public:
+#ifdef MFC_HAS_STRING_VIEW
+      typedef std::basic_string_view<TCHAR> view_type;
+#endif
+
+      class const_iterator
+      {
+      public:
+         typedef const_iterator                    self_type;
+         typedef LPCTSTR                           value_type;
+         typedef LPCTSTR                           reference;
+         typedef LPCTSTR const *                   pointer;
+         typedef std::random_access_iterator_tag   iterator_category;
+         typedef ptrdiff_t                         difference_type;
+
+      private:
+         bool compatible(self_type const& other) const
+         {
+            return m_collection == other.m_collection;
+         }
+
+      public:
+         explicit const_iterator(CPooledStringArray const & collection, INT_PTR const index) noexcept :
+            m_index(index),
+            m_collection(&collection)
+         {}
+
+         const_iterator() = default;
+
+         bool operator== (self_type const& other) const
+         {
+            assert(compatible(other));
+            return m_index == other.m_index;
+         }
+
+         bool operator!= (self_type const & other) const
+         {
+            return !(*this == other);
+         }
+
+         reference operator* () const
+         {
+            if (m_collection->IsEmpty())
+               throw std::exception("Illegal function call");
+
+            return (*m_collection)[m_index];
+         }
+
+         self_type& operator++ ()
+         {
+            if (m_index >= m_collection->GetSize())
+               throw std::out_of_range("Iterator cannot be incremented past the end of range.");
+            ++m_index;
+            return *this;
+         }
+
+         self_type operator++ (int)
+         {
+            self_type tmp = *this;
+            ++*this;
+            return tmp;
+         }
+
+         self_type& operator--()
+         {
+            if (m_index <= 0)
+               throw std::out_of_range("Iterator cannot be decremented past the end of range.");
+
+            --m_index;
+            return *this;
+         }
+
+         self_type operator--(int)
+         {
+            self_type tmp = *this;
+            --*this;
+            return tmp;
+         }
+
+         self_type& operator+=(difference_type const offset)
+         {
+            if (m_index + offset < 0 || m_index + offset > m_collection->GetSize())
+               throw std::out_of_range("Iterator cannot be incremented past the end of range.");
+
+            m_index += offset;
+            return *this;
+         }
+
+         self_type& operator-=(difference_type const offset)
+         {
+            return *this += -offset;
+         }
+
+         self_type operator+(difference_type offset) const
+         {
+            self_type tmp = *this;
+            return tmp += offset;
+         }
+
+         self_type operator-(difference_type offset) const
+         {
+            self_type tmp = *this;
+            return tmp -= offset;
+         }
+
+         difference_type operator-(self_type const& other) const
+         {
+            assert(compatible(other));
+            return (m_index - other.m_index);
+         }
+
+         bool operator<(self_type const& other) const
+         {
+            assert(compatible(other));
+            return m_index < other.m_index;
+         }
+
+         bool operator>(self_type const& other) const
+         {
+            return other < *this;
+         }
+
+         bool operator<=(self_type const& other) const
+         {
+            return !(other < *this);
+         }
+
+         bool operator>=(self_type const& other) const
+         {
+            return !(*this < other);
+         }
+
+         reference operator[](difference_type const offset) const
+         {
+            return *(*this + offset);
+         }
+
+      private:
+         INT_PTR                    m_index;
+         CPooledStringArray const * m_collection;
+      };
+
+      CPooledStringArray() = default;
+
+      explicit CPooledStringArray(CStringArray const & source)
+      {
+         Copy(source);
+      }
+
+      INT_PTR GetSize() const noexcept { return static_cast<INT_PTR>(m_offsets.size()); }
+      INT_PTR GetCount() const noexcept { return GetSize(); }
+      INT_PTR GetUpperBound() const noexcept { return GetSize() - 1; }
+      BOOL IsEmpty() const noexcept { return m_offsets.empty(); }
+
+      // number of characters stored for all strings, including their terminating nulls
+      size_t GetPoolSize() const noexcept { return m_chars.size(); }
+
+      void Reserve(INT_PTR const strings, size_t const chars)
+      {
+         m_offsets.reserve(static_cast<size_t>(strings));
+         m_chars.reserve(chars);
+      }
+
+      INT_PTR Add(LPCTSTR text, int const length)
+      {
+         ASSERT(length >= 0);
+         if (m_chars.size() + length + 1 > (std::numeric_limits<UINT>::max)())
+            AfxThrowMemoryException();
+
+         m_offsets.push_back(static_cast<UINT>(m_chars.size()));
+         m_chars.insert(m_chars.end(), text, text + length);
+         m_chars.push_back(_T('\0'));
+         return GetUpperBound();
+      }
+
+      INT_PTR Add(LPCTSTR text)
+      {
+         return Add(text, static_cast<int>(_tcslen(text)));
+      }
+
+      INT_PTR Add(CString const & text)
+      {
+         return Add(static_cast<LPCTSTR>(text), text.GetLength());
+      }
+
+      LPCTSTR GetAt(INT_PTR const index) const
+      {
+         ASSERT(index >= 0 && index < GetSize());
+         return m_chars.data() + m_offsets[static_cast<size_t>(index)];
+      }
+
+      LPCTSTR operator[](INT_PTR const index) const
+      {
+         return GetAt(index);
+      }
+
+      int GetLength(INT_PTR const index) const
+      {
+         ASSERT(index >= 0 && index < GetSize());
+         size_t const next = index + 1 < GetSize() ? m_offsets[static_cast<size_t>(index) + 1] : m_chars.size();
+         return static_cast<int>(next - m_offsets[static_cast<size_t>(index)] - 1);
+      }
+
+#ifdef MFC_HAS_STRING_VIEW
+      view_type GetView(INT_PTR const index) const
+      {
+         return view_type(GetAt(index), static_cast<size_t>(GetLength(index)));
+      }
+#endif
+
+      void RemoveAll() noexcept
+      {
+         m_offsets.clear();
+         m_chars.clear();
+      }
+
+      void FreeExtra()
+      {
+         m_offsets.shrink_to_fit();
+         m_chars.shrink_to_fit();
+      }
+
+      // replaces the content with the strings of source, sizing the pool once
+      void Copy(CStringArray const & source)
+      {
+         RemoveAll();
+
+         size_t chars = 0;
+         for (INT_PTR i = 0; i < source.GetSize(); ++i)
+            chars += static_cast<size_t>(source.GetAt(i).GetLength()) + 1;
+
+         Reserve(source.GetSize(), chars);
+         for (INT_PTR i = 0; i < source.GetSize(); ++i)
+            Add(source.GetAt(i));
+      }
+
+      // replaces the content of target with copies of the strings, sizing it once
+      void CopyTo(CStringArray& target) const
+      {
+         target.SetSize(GetSize());
+         for (INT_PTR i = 0; i < GetSize(); ++i)
+            target.SetAt(i, CString(GetAt(i), GetLength(i)));
+      }
+
+      const_iterator begin() const noexcept { return const_iterator(*this, 0); }
+      const_iterator end() const noexcept { return const_iterator(*this, GetSize()); }
+
+   private:
+      std::vector<TCHAR>   m_chars;
+      std::vector<UINT>    m_offsets;
+   };
+
+   inline CPooledStringArray::const_iterator begin(CPooledStringArray const & collection) noexcept
+   {
+      return collection.begin();
+   }
+
+   inline CPooledStringArray::const_iterator end(CPooledStringArray const & collection) noexcept
+   {
+      return collection.end();
+   }
+}
+
+#pragma endregion
+
+#pragma region string interning
+
+namespace mfc
+{
+   namespace detail
+   {
+      struct interned_entry
+      {
+         LPCTSTR  text;
+         int      length;
+         UINT     hash;
+      };
+   }
+
+   // Handle to a string stored by a CStringInterner. Equal strings interned by the same interner get the same
+   // handle, so comparing handles is a pointer compare and the hash is computed once, when the string is interned.
+   // The default handle is the empty string. Handles stay valid for the lifetime of their interner.
+   class CInternedString
+   {
+   public:
+      CInternedString() noexcept : m_entry(nullptr) {}
+
+      LPCTSTR GetString() const noexcept { return m_entry != nullptr ? m_entry->text : _T(""); }
+      int GetLength() const noexcept { return m_entry != nullptr ? m_entry->length : 0; }
+      UINT GetHash() const noexcept { return m_entry != nullptr ? m_entry->hash : 0; }
+      BOOL IsEmpty() const noexcept { return m_entry == nullptr; }
+
+      friend bool operator== (CInternedString const & left, CInternedString const & right) noexcept
+      {
+         return left.m_entry == right.m_entry;
+      }
+
+      friend bool operator!= (CInternedString const & left, CInternedString const & right) noexcept
+      {
+         return left.m_entry != right.m_entry;
+      }
+
+   private:
+      friend class CStringInterner;
+
+      explicit CInternedString(detail::interned_entry const * entry) noexcept : m_entry(entry) {}
+
+      detail::interned_entry const * m_entry;
+   };
+
+   // Deduplicating string store. Characters are kept in large blocks and looked up through an open addressing
+   // table of entries, so interning a string that is already known does not allocate. Not thread-safe.
+   class CStringInterner
+   {
+   public:
+      explicit CStringInterner(size_t const blockSize = 64 * 1024) :
+         m_next(nullptr),
+         m_available(0),
+         m_blockSize(blockSize),
+         m_allocated(0)
+      {
+         ASSERT(blockSize > 0);
+         m_table.resize(64, nullptr);
+      }
+
+      CStringInterner(CStringInterner const &) = delete;
+      CStringInterner& operator=(CStringInterner const &) = delete;
+
+      CInternedString Intern(LPCTSTR text, int const length)
+      {
+         ASSERT(length >= 0);
+         if (length == 0)
+            return CInternedString();
+
+         UINT const hash = Hash(text, length);
+         size_t index = Probe(text, length, hash);
+         if (m_table[index] != nullptr)
+            return CInternedString(m_table[index]);
+
+         if ((m_entries.size() + 1) * 2 > m_table.size())
+         {
+            Grow();
+            index = Probe(text, length, hash);
+         }
+
+         detail::interned_entry entry;
+         entry.text = Store(text, length);
+         entry.length = length;
+         entry.hash = hash;
+         m_entries.push_back(entry);
+         m_table[index] = &m_entries.back();
+
+         return CInternedString(m_table[index]);
+      }
+
+      CInternedString Intern(LPCTSTR text)
+      {
+         return Intern(text, static_cast<int>(_tcslen(text)));
+      }
+
+      CInternedString Intern(CString const & text)
+      {
+         return Intern(static_cast<LPCTSTR>(text), text.GetLength());
+      }
+
+      // finds the handle of a string without interning it
+      BOOL Lookup(LPCTSTR text, CInternedString& handle) const
+      {
+         int const length = static_cast<int>(_tcslen(text));
+         if (length == 0)
+         {
+            handle = CInternedString();
+            return TRUE;
+         }
+
+         detail::interned_entry const * const entry = m_table[Probe(text, length, Hash(text, length))];
+         if (entry == nullptr)
+            return FALSE;
+
+         handle = CInternedString(entry);
+         return TRUE;
+      }
+
+      // number of distinct strings
+      INT_PTR GetCount() const noexcept { return static_cast<INT_PTR>(m_entries.size()); }
+
+      // bytes allocated for characters, entries and the lookup table
+      size_t GetAllocatedBytes() const noexcept
+      {
+         return m_allocated * sizeof(TCHAR) +
+            m_entries.size() * sizeof(detail::interned_entry) +
+            m_table.capacity() * sizeof(detail::interned_entry const *);
+      }
+
+   private:
+      static UINT Hash(LPCTSTR text, int const length) noexcept
+      {
+         ULONGLONG h = 0xcbf29ce484222325ULL;
+         for (int i = 0; i < length; ++i)
+         {
+            h ^= static_cast<ULONGLONG>(text[i]);
+            h *= 0x100000001b3ULL;
+         }
+         h = detail::mix_hash(h);
+         return static_cast<UINT>(h ^ (h >> 32));
+      }
+
+      // slot holding the string, or the empty slot where it belongs
+      size_t Probe(LPCTSTR text, int const length, UINT const hash) const noexcept
+      {
+         size_t const mask = m_table.size() - 1;
+         size_t index = hash & mask;
+         for (;;)
+         {
+            detail::interned_entry const * const entry = m_table[index];
+            if (entry == nullptr ||
+                (entry->hash == hash && entry->length == length &&
+                 memcmp(entry->text, text, length * sizeof(TCHAR)) == 0))
+               return index;
+
+            index = (index + 1) & mask;
+         }
+      }
+
+      void Grow()
+      {
+         std::vector<detail::interned_entry const *> table(m_table.size() * 2, nullptr);
+         size_t const mask = table.size() - 1;
+         for (auto const & entry : m_entries)
+         {
+            size_t index = entry.hash & mask;
+            while (table[index] != nullptr)
+               index = (index + 1) & mask;
+            table[index] = &entry;
+         }
+         m_table.swap(table);
+      }
+
+      LPCTSTR Store(LPCTSTR text, int const length)
+      {
+         size_t const needed = static_cast<size_t>(length) + 1;
+         if (needed > m_available)
+         {
+            size_t const size = (std::max)(needed, m_blockSize);
+            m_blocks.emplace_back(new TCHAR[size]);
+            m_next = m_blocks.back().get();
+            m_available = size;
+            m_allocated += size;
+         }
+
+         TCHAR* const stored = m_next;
+         memcpy(stored, text, length * sizeof(TCHAR));
+         stored[length] = _T('\0');
+
+         m_next += needed;
+         m_available -= needed;
+         return stored;
+      }
+
+      std::deque<detail::interned_entry>              m_entries;
+      std::vector<detail::interned_entry const *>     m_table;
+      std::vector<std::unique_ptr<TCHAR[]>>           m_blocks;
+      TCHAR*                                          m_next;
+      size_t                                          m_available;
+      size_t const                                    m_blockSize;
+      size_t                                          m_allocated;
+   };
+
+   // Interns every string of an array, list or other range of CString or LPCTSTR into target.
+   template <typename C>
+   void intern_all(CStringInterner& interner, C const & strings, CArray<CInternedString>& target)
+   {
+      target.SetSize(strings.GetCount());
+
+      INT_PTR index = 0;
+      for (auto const & text : strings)
+         target[index++] = interner.Intern(text);
+   }
+
+   // Copies a map with string keys (CMapStringToPtr, CMapStringToString, CMap<CString, ...>) into a map keyed by interned strings.
+   template <typename M, typename TValue, typename TValueArg>
+   void intern_keys(CStringInterner& interner, M const & map, CMap<CInternedString, CInternedString, TValue, TValueArg>& target)
+   {
+      if (target.IsEmpty())
+         target.InitHashTable(detail::hash_table_size(map.GetCount()));
+
+      for (auto const & pair : map)
+         target.SetAt(interner.Intern(pair.key), pair.value);
+   }
+}
+
+// CMap<mfc::CInternedString, ...> uses the hash computed when the string was interned
+template<>
+inline UINT AFXAPI HashKey<mfc::CInternedString>(mfc::CInternedString key)
+{
+   return key.GetHash();
+}
+
+#pragma endregion
+
+#pragma region string join
+
+namespace mfc
+{
+   // view of a part of a string, as produced by split
+#ifdef MFC_HAS_STRING_VIEW
+   typedef std::basic_string_view<TCHAR> token_view;
+#else
+   // minimal stand-in for std::basic_string_view<TCHAR> before C++17
+   class token_view
+   {
+   public:
+      token_view() noexcept : m_text(nullptr), m_length(0) {}
+      token_view(LPCTSTR text, size_t const length) noexcept : m_text(text), m_length(length) {}
+
+      LPCTSTR data() const noexcept { return m_text; }
+      size_t size() const noexcept { return m_length; }
+      size_t length() const noexcept { return m_length; }
+      bool empty() const noexcept { return m_length == 0; }
+      LPCTSTR begin() const noexcept { return m_text; }
+      LPCTSTR end() const noexcept { return m_text + m_length; }
+      TCHAR operator[](size_t const index) const noexcept { return m_text[index]; }
+
+      friend bool operator== (token_view const & left, token_view const & right) noexcept
+      {
+         return left.m_length == right.m_length && memcmp(left.m_text, right.m_text, left.m_length * sizeof(TCHAR)) == 0;
+      }
+
+      friend bool operator!= (token_view const & left, token_view const & right) noexcept
+      {
+         return !(left == right);
+      }
+
+   private:
+      LPCTSTR  m_text;
+      size_t   m_length;
+   };
+#endif
+
+   namespace detail
+   {
+      struct text_ref
+      {
+         LPCTSTR  text;
+         int      length;
+      };
+
+      inline text_ref text_of(CString const & str) noexcept
+      {
+         text_ref ref = { static_cast<LPCTSTR>(str), str.GetLength() };
+         return ref;
+      }
+
+      inline text_ref text_of(LPCTSTR str) noexcept
+      {
+         text_ref ref = { str, static_cast<int>(_tcslen(str)) };
+         return ref;
+      }
+
+      inline text_ref text_of(CInternedString const & str) noexcept
+      {
+         text_ref ref = { str.GetString(), str.GetLength() };
+         return ref;
+      }
+
+      inline text_ref text_of(token_view const & str) noexcept
+      {
+         text_ref ref = { str.data(), static_cast<int>(str.size()) };
+         return ref;
+      }
+
+      struct identity
+      {
+         template <typename T>
+         T const & operator()(T const & value) const noexcept { return value; }
+      };
+   }
+
+   // projections selecting the key or the value of a map element
+   struct pair_key
+   {
+      template <typename TPair>
+      auto operator()(TPair const & pair) const noexcept -> decltype((pair.key)) { return pair.key; }
+   };
+
+   struct pair_value
+   {
+      template <typename TPair>
+      auto operator()(TPair const & pair) const noexcept -> decltype((pair.value)) { return pair.value; }
+   };
+
+   // Concatenates the strings projection(element) of a range, separated by separator. The total length is computed
+   // first so the result buffer is allocated once with GetBufferSetLength and then filled in a second pass.
+   template <typename C, typename Projection>
+   CString join(C const & strings, LPCTSTR separator, Projection projection)
+   {
+      detail::text_ref const sep = detail::text_of(separator);
+
+      ULONGLONG length = 0;
+      bool first = true;
+      for (auto const & element : strings)
+      {
+         if (!first)
+            length += sep.length;
+         first = false;
+         length += detail::text_of(projection(element)).length;
+      }
+
+      CString result;
+      if (length == 0)
+         return result;
+      if (length > static_cast<ULONGLONG>((std::numeric_limits<int>::max)()))
+         AfxThrowMemoryException();
+
+      LPTSTR const buffer = result.GetBufferSetLength(static_cast<int>(length));
+      LPTSTR next = buffer;
+      first = true;
+      for (auto const & element : strings)
+      {
+         if (!first)
+         {
+            memcpy(next, sep.text, sep.length * sizeof(TCHAR));
+            next += sep.length;
+         }
+         first = false;
+
+         detail::text_ref const text = detail::text_of(projection(element));
+         memcpy(next, text.text, text.length * sizeof(TCHAR));
+         next += text.length;
+      }
+
+      ASSERT(next == buffer + length);
+      result.ReleaseBufferSetLength(static_cast<int>(length));
+      return result;
+   }
+
+   // Joins a range of CString, LPCTSTR, CInternedString or token_view (CStringArray, CStringList, CPooledStringArray, split, ...).
+   template <typename C>
+   CString join(C const & strings, LPCTSTR separator)
+   {
+      return join(strings, separator, detail::identity());
+   }
+
+   template <typename C>
+   CString concat(C const & strings)
+   {
+      return join(strings, _T(""), detail::identity());
+   }
+
+   // Joins the keys or the values of a map with string keys or values (CMapStringToString, CMap<CString, ...>, ...).
+   template <typename M>
+   CString join_keys(M const & map, LPCTSTR separator)
+   {
+      return join(map, separator, pair_key());
+   }
+
+   template <typename M>
+   CString join_values(M const & map, LPCTSTR separator)
+   {
+      return join(map, separator, pair_value());
+   }
+}
+
+#pragma endregion
+
+#pragma region string split
+
+namespace mfc
+{
+   enum class empty_tokens
+   {
+      skip,    // consecutive delimiters are treated as one, as CString::Tokenize does
+      keep
+   };
+
+   namespace detail
+   {
+      // Finds the next delimiter. With SSE2, up to MaxVectorDelimiters delimiters, a single one included, are
+      // compared against 16 bytes of text at a time (find_vectorized). Larger sets, and every set in builds without
+      // SSE2, go through char_traits::find (memchr/wmemchr) for a single delimiter and through a table for ASCII
+      // characters otherwise. The delimiters are copied, so they need not outlive the set.
+#ifdef MFC_HAS_SSE2
+      // SSE2 compares of one 16-byte block against a broadcast character, by character width
+      template <size_t Width>
+      struct simd_chars;
+
+      template <>
+      struct simd_chars<1>
+      {
+         static __m128i broadcast(TCHAR const ch) noexcept { return _mm_set1_epi8(static_cast<char>(ch)); }
+         static __m128i equal(__m128i const a, __m128i const b) noexcept { return _mm_cmpeq_epi8(a, b); }
+      };
+
+      template <>
+      struct simd_chars<2>
+      {
+         static __m128i broadcast(TCHAR const ch) noexcept { return _mm_set1_epi16(static_cast<short>(ch)); }
+         static __m128i equal(__m128i const a, __m128i const b) noexcept { return _mm_cmpeq_epi16(a, b); }
+      };
+
+      template <>
+      struct simd_chars<4>
+      {
+         static __m128i broadcast(TCHAR const ch) noexcept { return _mm_set1_epi32(static_cast<int>(ch)); }
+         static __m128i equal(__m128i const a, __m128i const b) noexcept { return _mm_cmpeq_epi32(a, b); }
+      };
+
+      inline unsigned lowest_bit(unsigned const mask) noexcept
+      {
+#ifdef _MSC_VER
+         unsigned long index;
+         _BitScanForward(&index, mask);
+         return static_cast<unsigned>(index);
+#else
+         return static_cast<unsigned>(__builtin_ctz(mask));
+#endif
+      }
+#endif
+
+      class delimiter_set
+      {
+      public:
+         explicit delimiter_set(LPCTSTR delimiters) :
+            m_delimiters(delimiters),
+            m_single(_T('\0')),
+            m_wide(false)
+         {
+            ASSERT(!m_delimiters.IsEmpty());
+            memset(m_ascii, 0, sizeof(m_ascii));
+            for (int i = 0; i < m_delimiters.GetLength(); ++i)
+            {
+               TCHAR const ch = m_delimiters[i];
+               if (static_cast<unsigned>(ch) < 128)
+                  m_ascii[static_cast<unsigned>(ch)] = true;
+               else
+                  m_wide = true;
+            }
+
+            if (m_delimiters.GetLength() == 1)
+               m_single = m_delimiters[0];
+         }
+
+         LPCTSTR find(LPCTSTR first, LPCTSTR const last) const noexcept
+         {
+#ifdef MFC_HAS_SSE2
+            if (m_delimiters.GetLength() <= MaxVectorDelimiters)
+               return find_vectorized(first, last);
+#endif
+
+            if (m_single != _T('\0'))
+            {
+               LPCTSTR const found = std::char_traits<TCHAR>::find(first, static_cast<size_t>(last - first), m_single);
+               return found != nullptr ? found : last;
+            }
+
+            for (; first != last; ++first)
+            {
+               unsigned const ch = static_cast<unsigned>(*first);
+               if (ch < 128 ? m_ascii[ch] : (m_wide && is_wide_delimiter(*first)))
+                  return first;
+            }
+            return last;
+         }
+
+      private:
+#ifdef MFC_HAS_SSE2
+         enum { MaxVectorDelimiters = 4 };
+
+         // compares 16 bytes of text against every delimiter per step; the movemask of the combined
+         // comparison gives the first match
+         LPCTSTR find_vectorized(LPCTSTR first, LPCTSTR const last) const noexcept
+         {
+            typedef simd_chars<sizeof(TCHAR)> chars;
+            int const lanes = 16 / sizeof(TCHAR);
+            int const count = m_delimiters.GetLength();
+            LPCTSTR const delimiters = m_delimiters;
+
+            __m128i keys[MaxVectorDelimiters];
+            for (int i = 0; i < count; ++i)
+               keys[i] = chars::broadcast(delimiters[i]);
+
+            for (; last - first >= lanes; first += lanes)
+            {
+               __m128i const block = _mm_loadu_si128(reinterpret_cast<__m128i const *>(first));
+               __m128i hits = chars::equal(block, keys[0]);
+               for (int i = 1; i < count; ++i)
+                  hits = _mm_or_si128(hits, chars::equal(block, keys[i]));
+
+               unsigned const mask = static_cast<unsigned>(_mm_movemask_epi8(hits));
+               if (mask != 0)
+                  return first + lowest_bit(mask) / sizeof(TCHAR);
+            }
+
+            for (; first != last; ++first)
+               if (std::char_traits<TCHAR>::find(delimiters, static_cast<size_t>(count), *first) != nullptr)
+                  return first;
+            return last;
+         }
+#endif
+
+         bool is_wide_delimiter(TCHAR const ch) const noexcept
+         {
+            LPCTSTR const delimiters = m_delimiters;
+            return std::char_traits<TCHAR>::find(delimiters, m_delimiters.GetLength(), ch) != nullptr;
+         }
+
+         CString  m_delimiters;
+         TCHAR    m_single;
+         bool     m_wide;
+         bool     m_ascii[128];
+      };
+   }
+
+   // Lazy range of the tokens of a text, returned as views into the text; no token is copied or allocated.
+   // The range keeps its own copy of the delimiters, which is its only allocation. The text must outlive the range.
+   class CTokenRange
+   {
+   public:
+      class iterator
+      {
+      public:
+         typedef std::forward_iterator_tag   iterator_category;
+         typedef token_view                  value_type;
+         typedef std::ptrdiff_t              difference_type;
+         typedef token_view const *          pointer;
+         typedef token_view const &          reference;
+
+         iterator() noexcept : m_range(nullptr), m_next(nullptr) {}
+
+         iterator(CTokenRange const * range, LPCTSTR first) : m_range(range), m_next(first)
+         {
+            advance();
+         }
+
+         reference operator* () const noexcept { return m_token; }
+         pointer operator-> () const noexcept { return &m_token; }
+
+         iterator& operator++ ()
+         {
+            advance();
+            return *this;
+         }
+
+         iterator operator++ (int)
+         {
+            iterator tmp = *this;
+            advance();
+            return tmp;
+         }
+
+         bool operator== (iterator const & other) const noexcept
+         {
+            return m_range == other.m_range && m_next == other.m_next && m_token.data() == other.m_token.data();
+         }
+
+         bool operator!= (iterator const & other) const noexcept
+         {
+            return !(*this == other);
+         }
+
+      private:
+         void advance()
+         {
+            while (m_next != nullptr)
+            {
+               LPCTSTR const start = m_next;
+               LPCTSTR const stop = m_range->m_delimiters.find(start, m_range->m_last);
+               m_next = stop == m_range->m_last ? nullptr : stop + 1;
+
+               if (stop != start || m_range->m_empty == empty_tokens::keep)
+               {
+                  m_token = token_view(start, static_cast<size_t>(stop - start));
+                  return;
+               }
+            }
+
+            // past the end
+            m_range = nullptr;
+            m_token = token_view();
+         }
+
+         CTokenRange const *  m_range;
+         LPCTSTR              m_next;
+         token_view           m_token;
+      };
+
+      CTokenRange(LPCTSTR text, int const length, LPCTSTR delimiters, empty_tokens const empty) :
+         m_first(text),
+         m_last(text + length),
+         m_delimiters(delimiters),
+         m_empty(empty)
+      {
+         ASSERT(length >= 0);
+      }
+
+      iterator begin() const { return iterator(this, m_first); }
+      iterator end() const noexcept { return iterator(); }
+
+   private:
+      LPCTSTR                 m_first;
+      LPCTSTR                 m_last;
+      detail::delimiter_set   m_delimiters;
+      empty_tokens            m_empty;
+   };
+
+   inline CTokenRange split(LPCTSTR text, int const length, LPCTSTR delimiters, empty_tokens const empty = empty_tokens::skip)
+   {
+      return CTokenRange(text, length, delimiters, empty);
+   }
+
+   inline CTokenRange split(CString const & text, LPCTSTR delimiters, empty_tokens const empty = empty_tokens::skip)
+   {
+      return CTokenRange(text, text.GetLength(), delimiters, empty);
+   }
+
+   // the range points into the text, so it must not be a temporary
+   CTokenRange split(CString const && text, LPCTSTR delimiters, empty_tokens const empty = empty_tokens::skip) = delete;
+
+   // Splits text into target, replacing its content. The tokens are counted first so the array is sized once.
+   inline void split_into(CString const & text, LPCTSTR delimiters, CStringArray& target, empty_tokens const empty = empty_tokens::skip)
+   {
+      CTokenRange const tokens = split(text, delimiters, empty);
+
+      INT_PTR count = 0;
+      for (auto it = tokens.begin(); it != tokens.end(); ++it)
+         ++count;
+
+      target.SetSize(count);
+
+      INT_PTR index = 0;
+      for (auto const & token : tokens)
+         target[index++].SetString(token.data(), static_cast<int>(token.size()));
+   }
+
+   // Splits text into target, replacing its content, with a single allocation for the characters of all tokens.
+   inline void split_into(CString const & text, LPCTSTR delimiters, CPooledStringArray& target, empty_tokens const empty = empty_tokens::skip)
+   {
+      CTokenRange const tokens = split(text, delimiters, empty);
+
+      INT_PTR count = 0;
+      size_t chars = 0;
+      for (auto const & token : tokens)
+      {
+         ++count;
+         chars += token.size() + 1;
+      }
+
+      target.RemoveAll();
+      target.Reserve(count, chars);
+      for (auto const & token : tokens)
+         target.Add(token.data(), static_cast<int>(token.size()));
+   }
+}
+
+#pragma endregion
+
+#pragma region runtime class views
+
+namespace mfc
+{
+   namespace detail
+   {
+      template <typename C>
+      struct collection_iterator
+      {
+         typedef decltype(begin(std::declval<C&>())) type;
+      };
+
+      // Remembers, for each runtime class met, whether it derives from the target class,
+      // so the CRuntimeClass base chain is walked once per class instead of once per object.
+      class kind_cache
+      {
+      public:
+         explicit kind_cache(CRuntimeClass const * target) : m_target(target)
+         {
+         }
+
+         bool matches(CObject const * object)
+         {
+            if (object == nullptr)
+               return false;
+
+            CRuntimeClass const * const runtimeClass = object->GetRuntimeClass();
+            if (runtimeClass == m_lastClass)
+               return m_lastMatch;
+
+            auto const pos = std::find_if(m_classes.begin(), m_classes.end(),
+               [runtimeClass](std::pair<CRuntimeClass const *, bool> const & entry) { return entry.first == runtimeClass; });
+
+            bool match;
+            if (pos != m_classes.end())
+            {
+               match = pos->second;
+            }
+            else
+            {
+               match = runtimeClass->IsDerivedFrom(m_target) != FALSE;
+               m_classes.push_back(std::make_pair(runtimeClass, match));
+            }
+
+            m_lastClass = runtimeClass;
+            m_lastMatch = match;
+            return match;
+         }
+
+      private:
+         CRuntimeClass const *                                    m_target;
+         CRuntimeClass const *                                    m_lastClass = nullptr;
+         bool                                                     m_lastMatch = false;
+         std::vector<std::pair<CRuntimeClass const *, bool>>      m_classes;
+      };
+   }
+
+   // Forward view of the elements of a CObArray or CObList that are of the given runtime class or derived from it,
+   // yielding T* (T const* for a const CObList). Null elements are skipped.
+   template <typename T, typename C>
+   class CKindView
+   {
+      typedef typename detail::collection_iterator<C>::type                                         base_iterator;
+      typedef typename std::decay<decltype(*std::declval<base_iterator&>())>::type                element_type;
+      typedef typename std::conditional<
+         std::is_const<typename std::remove_pointer<element_type>::type>::value, T const, T>::type   object_type;
+
+   public:
+      class iterator
+      {
+      public:
+         typedef std::forward_iterator_tag   iterator_category;
+         typedef object_type*                value_type;
+         typedef std::ptrdiff_t              difference_type;
+         typedef object_type* const *        pointer;
+         typedef object_type*                reference;
+
+         iterator(CKindView* view, base_iterator pos, base_iterator last) :
+            m_view(view),
+            m_pos(pos),
+            m_last(last),
+            m_current(nullptr)
+         {
+            skip();
+         }
+
+         reference operator* () const noexcept
+         {
+            return m_current;
+         }
+
+         iterator& operator++ ()
+         {
+            ++m_pos;
+            skip();
+            return *this;
+         }
+
+         iterator operator++ (int)
+         {
+            iterator tmp = *this;
+            ++*this;
+            return tmp;
+         }
+
+         bool operator!= (iterator const & other) const
+         {
+            return m_pos != other.m_pos;
+         }
+
+         bool operator== (iterator const & other) const
+         {
+            return !(*this != other);
+         }
+
+      private:
+         void skip()
+         {
+            for (; m_pos != m_last; ++m_pos)
+            {
+               element_type const object = *m_pos;
+               if (m_view->m_kinds.matches(object))
+               {
+                  m_current = static_cast<object_type*>(object);
+                  return;
+               }
+            }
+            m_current = nullptr;
+         }
+
+         CKindView*     m_view;
+         base_iterator  m_pos;
+         base_iterator  m_last;
+         object_type*   m_current;
+      };
+
+      CKindView(C& collection, CRuntimeClass const * runtimeClass) :
+         m_collection(collection),
+         m_kinds(runtimeClass)
+      {
+      }
+
+      iterator begin() { return iterator(this, ::begin(m_collection), ::end(m_collection)); }
+      iterator end() { return iterator(this, ::end(m_collection), ::end(m_collection)); }
+
+   private:
+      C&                   m_collection;
+      detail::kind_cache   m_kinds;
+   };
+
+   // runtimeClass must be RUNTIME_CLASS(T); the OF_KIND macro passes it
+   template <typename T, typename C>
+   inline CKindView<T, C> of_kind(C& collection, CRuntimeClass const * runtimeClass)
+   {
+      static_assert(std::is_base_of<CObject, T>::value, "of_kind requires a CObject-derived class");
+      ASSERT(runtimeClass != nullptr);
+      ASSERT(runtimeClass->m_nObjectSize == sizeof(T));
+      return CKindView<T, C>(collection, runtimeClass);
+   }
+
+   // T must have a DECLARE_DYNAMIC (or DYNCREATE/SERIAL) of its own. A class without one inherits GetThisClass
+   // from its base, which would select base objects as T; the size check only catches that when T adds members.
+   // Prefer OF_KIND: outside _AFXDLL builds RUNTIME_CLASS names T's own class member and fails to compile.
+   template <typename T, typename C>
+   inline CKindView<T, C> of_kind(C& collection)
+   {
+      return of_kind<T>(collection, T::GetThisClass());
+   }
+}
+
+// for (CCircle* circle : OF_KIND(CCircle, shapes)) ...
+#define OF_KIND(class_name, collection) mfc::of_kind<class_name>(collection, RUNTIME_CLASS(class_name))
+
+#pragma endregion
+
+#pragma region pointer compaction
+
+namespace mfc
+{
+   namespace detail
+   {
+      // Contiguous storage for objects moved out of the heap by CCompactable::Compact.
+      template <typename T>
+      class compact_block
+      {
+         static_assert(alignof(T) <= alignof(std::max_align_t), "over-aligned types are not supported");
+         // a pointer to a base of a polymorphic class may point to a derived object, which moving as T would slice
+         static_assert(!std::is_polymorphic<T>::value || std::is_final<T>::value,
+            "polymorphic objects can only be compacted when the class is final");
+
+      public:
+         explicit compact_block(size_t const capacity) :
+            m_storage(static_cast<T*>(::operator new(capacity * sizeof(T)))),
+            m_capacity(capacity),
+            m_used(0),
+            m_live(0),
+            m_alive(capacity, false)
+         {
+         }
+
+         compact_block(compact_block const &) = delete;
+         compact_block& operator=(compact_block const &) = delete;
+
+         ~compact_block()
+         {
+            for (size_t i = m_used; i > 0; --i)
+               if (m_alive[i - 1])
+                  m_storage[i - 1].~T();
+
+            ::operator delete(m_storage);
+         }
+
+         T* relocate(T& object)
+         {
+            ASSERT(m_used < m_capacity);
+            T* const slot = new (m_storage + m_used) T(std::move(object));
+            m_alive[m_used++] = true;
+            ++m_live;
+            return slot;
+         }
+
+         bool contains(T const * object) const noexcept
+         {
+            std::less<T const *> const less;
+            return !less(object, m_storage) && less(object, m_storage + m_used);
+         }
+
+         void destroy(T* object) noexcept
+         {
+            size_t const index = static_cast<size_t>(object - m_storage);
+            ASSERT(m_alive[index]);
+            object->~T();
+            m_alive[index] = false;
+            --m_live;
+         }
+
+         size_t live() const noexcept { return m_live; }
+
+      private:
+         T*                   m_storage;
+         size_t               m_capacity;
+         size_t               m_used;
+         size_t               m_live;
+         std::vector<bool>    m_alive;
+      };
+   }
+
+   // Typed-pointer container (CTypedPtrArray<CPtrArray, T*>, CTypedPtrList<CPtrList, T*>) that can move its
+   // pointees into contiguous storage it owns. Compact() move-constructs the objects, in iteration order, into a
+   // single block, deletes the originals and rewrites the stored pointers, so a traversal reads memory sequentially.
+   // Each object must be stored once, and a polymorphic object type must be final. Since compacted objects are not
+   // heap blocks of their own, they must be released with DeleteElement or DeleteAll instead of delete. Objects still
+   // in the compacted storage are destroyed with the container.
+   template <typename C>
+   class CCompactable : public C
+   {
+   public:
+      typedef typename std::remove_pointer<typename std::decay<decltype(*begin(std::declval<C&>()))>::type>::type object_type;
+
+      CCompactable() = default;
+      CCompactable(CCompactable const &) = delete;
+      CCompactable& operator=(CCompactable const &) = delete;
+
+      ~CCompactable()
+      {
+         C::RemoveAll();
+      }
+
+      void Compact()
+      {
+         C& elements = *this;
+
+         std::unique_ptr<detail::compact_block<object_type>> block(
+            new detail::compact_block<object_type>(static_cast<size_t>(elements.GetCount())));
+         detail::compact_block<object_type>& target = *block;
+         m_blocks.push_back(std::move(block));
+
+         for (auto& element : elements)
+         {
+            if (element == nullptr)
+               continue;
+
+            object_type* const moved = target.relocate(*element);
+            Dispose(element);
+            element = moved;
+         }
+
+         Trim();
+      }
+
+      // true if the object lives in the compacted storage rather than in its own heap block
+      BOOL IsCompacted(object_type const * object) const noexcept
+      {
+         return FindBlock(object) != nullptr;
+      }
+
+      // destroys an object of the container, wherever it is stored; it is not removed from the container
+      void DeleteElement(object_type* object)
+      {
+         Dispose(object);
+         Trim();
+      }
+
+      // destroys all the objects and removes them from the container
+      void DeleteAll()
+      {
+         C& elements = *this;
+         for (auto& element : elements)
+         {
+            if (element != nullptr)
+               Dispose(element);
+         }
+
+         C::RemoveAll();
+         m_blocks.clear();
+      }
+
+   private:
+      detail::compact_block<object_type>* FindBlock(object_type const * object) const noexcept
+      {
+         for (auto const & block : m_blocks)
+            if (block->contains(object))
+               return block.get();
+         return nullptr;
+      }
+
+      void Dispose(object_type* object)
+      {
+         detail::compact_block<object_type>* const block = FindBlock(object);
+         if (block != nullptr)
+            block->destroy(object);
+         else
+            delete object;
+      }
+
+      // frees the storage of blocks whose objects were all moved or deleted
+      void Trim()
+      {
+         m_blocks.erase(
+            std::remove_if(m_blocks.begin(), m_blocks.end(),
+               [](std::unique_ptr<detail::compact_block<object_type>> const & block) { return block->live() == 0; }),
+            m_blocks.end());
+      }
+
+      std::vector<std::unique_ptr<detail::compact_block<object_type>>> m_blocks;
+   };
+}
+
+#pragma endregion
+
+#pragma region arena ownership
+
+namespace mfc
+{
+   // Bump allocator for objects that are all destroyed together. Objects are placed one after another in large
+   // blocks; Release() runs the destructors of the objects that have one, most recent first, and frees the blocks
+   // without an individual free per object. Not thread-safe.
+   class CObjectArena
+   {
+   public:
+      explicit CObjectArena(size_t const blockSize = 64 * 1024) :
+         m_next(nullptr),
+         m_available(0),
+         m_blockSize(blockSize),
+         m_allocated(0),
+         m_destructors(nullptr)
+      {
+         ASSERT(blockSize > 0);
+      }
+
+      CObjectArena(CObjectArena const &) = delete;
+      CObjectArena& operator=(CObjectArena const &) = delete;
+
+      ~CObjectArena()
+      {
+         Release();
+      }
+
+      template <typename T, typename... Args>
+      T* New(Args&&... args)
+      {
+         static_assert(alignof(T) <= alignof(std::max_align_t), "over-aligned types are not supported");
+
+         if (std::is_trivially_destructible<T>::value)
+            return new (Allocate(sizeof(T), alignof(T))) T(std::forward<Args>(args)...);
+
+         // the record is placed before the object so a failed constructor leaves no record behind
+         destructor_record* const record = static_cast<destructor_record*>(Allocate(sizeof(destructor_record), alignof(destructor_record)));
+         T* const object = new (Allocate(sizeof(T), alignof(T))) T(std::forward<Args>(args)...);
+
+         record->destroy = &destroy<T>;
+         record->object = object;
+         record->next = m_destructors;
+         m_destructors = record;
+         return object;
+      }
+
+      void* Allocate(size_t const size, size_t const alignment)
+      {
+         ASSERT(alignment > 0 && (alignment & (alignment - 1)) == 0);
+
+         size_t padding = m_next != nullptr ? (alignment - reinterpret_cast<UINT_PTR>(m_next) % alignment) % alignment : 0;
+         if (m_next == nullptr || padding + size > m_available)
+         {
+            size_t const blockSize = (std::max)(m_blockSize, size + alignment);
+            BYTE* const block = static_cast<BYTE*>(::operator new(blockSize));
+            m_blocks.push_back(block);
+            m_allocated += blockSize;
+            m_next = block;
+            m_available = blockSize;
+            padding = (alignment - reinterpret_cast<UINT_PTR>(m_next) % alignment) % alignment;
+         }
+
+         void* const memory = m_next + padding;
+         m_next += padding + size;
+         m_available -= padding + size;
+         return memory;
+      }
+
+      // destroys all the objects and frees all the blocks
+      void Release() noexcept
+      {
+         for (destructor_record* record = m_destructors; record != nullptr; record = record->next)
+            record->destroy(record->object);
+         m_destructors = nullptr;
+
+         for (BYTE* block : m_blocks)
+            ::operator delete(block);
+         m_blocks.clear();
+
+         m_next = nullptr;
+         m_available = 0;
+         m_allocated = 0;
+      }
+
+      size_t GetAllocatedBytes() const noexcept { return m_allocated; }
+
+   private:
+      struct destructor_record
+      {
+         void (*destroy)(void*);
+         void*                object;
+         destructor_record*   next;
+      };
+
+      template <typename T>
+      static void destroy(void* object) noexcept
+      {
+         static_cast<T*>(object)->~T();
+      }
+
+      BYTE*                m_next;
+      size_t               m_available;
+      size_t const         m_blockSize;
+      size_t               m_allocated;
+      std::vector<BYTE*>   m_blocks;
+      destructor_record*   m_destructors;
+   };
+
+   namespace detail
+   {
+      // the pointer owned through an element: the element itself (arrays, lists) or its value (maps)
+      template <typename E, typename = void>
+      struct owned_pointer
+      {
+         typedef E type;
+         static E get(E const & element) noexcept { return element; }
+      };
+
+      template <typename E>
+      struct owned_pointer<E, typename make_void<decltype(std::declval<E const &>().value)>::type>
+      {
+         typedef typename std::decay<decltype(std::declval<E const &>().value)>::type type;
+         static type get(E const & element) noexcept { return element.value; }
+      };
+
+      template <typename C>
+      struct owned_element
+      {
+         typedef typename std::decay<decltype(*begin(std::declval<C&>()))>::type element_type;
+         typedef typename owned_pointer<element_type>::type pointer_type;
+         typedef typename std::remove_pointer<pointer_type>::type object_type;
+      };
+   }
+
+   // Deletes the objects a typed-pointer array, list or map points to (map values) and empties the container.
+   template <typename C>
+   void delete_all(C& collection)
+   {
+      typedef typename detail::owned_element<C>::element_type element_type;
+
+      for (auto const & element : collection)
+         delete detail::owned_pointer<element_type>::get(element);
+
+      collection.RemoveAll();
+   }
+
+   // Typed-pointer container whose objects are allocated from an arena it owns. Objects are created with New
+   // and added to the container as usual; Release() empties the container and destroys all the objects at once.
+   template <typename C>
+   class CArenaOwned : public C
+   {
+   public:
+      typedef typename detail::owned_element<C>::object_type object_type;
+
+      explicit CArenaOwned(size_t const blockSize = 64 * 1024) : m_arena(blockSize)
+      {
+      }
+
+      CArenaOwned(CArenaOwned const &) = delete;
+      CArenaOwned& operator=(CArenaOwned const &) = delete;
+
+      ~CArenaOwned()
+      {
+         Release();
+      }
+
+      template <typename... Args>
+      object_type* New(Args&&... args)
+      {
+         return m_arena.New<object_type>(std::forward<Args>(args)...);
+      }
+
+      void Release() noexcept
+      {
+         C::RemoveAll();
+         m_arena.Release();
+      }
+
+      CObjectArena& GetArena() noexcept { return m_arena; }
+
+   private:
+      CObjectArena m_arena;
+   };
+}
+
+#pragma endregion
+
+#pragma region chunked arrays
+
+namespace mfc
+{
+   // Array stored in fixed-size chunks reached through a chunk index, with the CArray members most code uses.
+   // Growing allocates new chunks and never moves the existing elements, so references and pointers to elements
+   // stay valid and memory is not doubled during a reallocation. Iterators are CTypeArrayIterator's.
+   template <typename T, typename TArg = T const &, INT_PTR ChunkSize = 4096>
+   class CChunkedArray
+   {
+      static_assert(ChunkSize > 0 && (ChunkSize & (ChunkSize - 1)) == 0, "ChunkSize must be a power of two");
+      static_assert(alignof(T) <= alignof(std::max_align_t), "over-aligned types are not supported");
+
+   public:
+      typedef CTypeArrayIterator<CChunkedArray, T>                iterator;
+      typedef CTypeArrayIterator<CChunkedArray const, T const>    const_iterator;
+
+      CChunkedArray() noexcept : m_size(0)
+      {
+      }
+
+      CChunkedArray(CChunkedArray const &) = delete;
+      CChunkedArray& operator=(CChunkedArray const &) = delete;
+
+      ~CChunkedArray()
+      {
+         RemoveAll();
+      }
+
+      INT_PTR GetSize() const noexcept { return m_size; }
+      INT_PTR GetCount() const noexcept { return m_size; }
+      INT_PTR GetUpperBound() const noexcept { return m_size - 1; }
+      BOOL IsEmpty() const noexcept { return m_size == 0; }
+
+      // nGrowBy is accepted for compatibility with CArray; the array always grows by whole chunks
+      void SetSize(INT_PTR const nNewSize, INT_PTR const nGrowBy = -1)
+      {
+         UNREFERENCED_PARAMETER(nGrowBy);
+         ASSERT(nNewSize >= 0);
+
+         if (nNewSize > m_size)
+         {
+            Reserve(nNewSize);
+            while (m_size < nNewSize)
+            {
+               ::new (Slot(m_size)) T();
+               ++m_size;
+            }
+         }
+         else
+         {
+            while (m_size > nNewSize)
+               Slot(--m_size)->~T();
+         }
+      }
+
+      INT_PTR Add(TArg newElement)
+      {
+         Reserve(m_size + 1);
+         ::new (Slot(m_size)) T(newElement);
+         return m_size++;
+      }
+
+      T const & GetAt(INT_PTR const nIndex) const
+      {
+         ASSERT(nIndex >= 0 && nIndex < m_size);
+         return *Slot(nIndex);
+      }
+
+      T& GetAt(INT_PTR const nIndex)
+      {
+         ASSERT(nIndex >= 0 && nIndex < m_size);
+         return *Slot(nIndex);
+      }
+
+      T& ElementAt(INT_PTR const nIndex)
+      {
+         return GetAt(nIndex);
+      }
+
+      void SetAt(INT_PTR const nIndex, TArg newElement)
+      {
+         GetAt(nIndex) = newElement;
+      }
+
+      void SetAtGrow(INT_PTR const nIndex, TArg newElement)
+      {
+         ASSERT(nIndex >= 0);
+         if (nIndex >= m_size)
+            SetSize(nIndex + 1);
+         GetAt(nIndex) = newElement;
+      }
+
+      T const & operator[](INT_PTR const nIndex) const
+      {
+         return GetAt(nIndex);
+      }
+
+      T& operator[](INT_PTR const nIndex)
+      {
+         return GetAt(nIndex);
+      }
+
+      // destroys all the elements and frees all the chunks
+      void RemoveAll() noexcept
+      {
+         SetSize(0);
+         for (T* const chunk : m_chunks)
+            ::operator delete(chunk);
+         std::vector<T*>().swap(m_chunks);
+      }
+
+      // frees the chunks past the last element
+      void FreeExtra()
+      {
+         size_t const needed = static_cast<size_t>((m_size + ChunkSize - 1) / ChunkSize);
+         while (m_chunks.size() > needed)
+         {
+            ::operator delete(m_chunks.back());
+            m_chunks.pop_back();
+         }
+         m_chunks.shrink_to_fit();
+      }
+
+      iterator begin() noexcept { return iterator(*this, 0); }
+      iterator end() noexcept { return iterator(*this, m_size); }
+      const_iterator begin() const noexcept { return const_iterator(*this, 0); }
+      const_iterator end() const noexcept { return const_iterator(*this, m_size); }
+
+   private:
+      T* Slot(INT_PTR const nIndex) const noexcept
+      {
+         size_t const index = static_cast<size_t>(nIndex);
+         return m_chunks[index / ChunkSize] + index % ChunkSize;
+      }
+
+      void Reserve(INT_PTR const count)
+      {
+         size_t const needed = static_cast<size_t>((count + ChunkSize - 1) / ChunkSize);
+         if (needed <= m_chunks.size())
+            return;
+
+         // the index grows geometrically and is reserved up front, so push_back cannot throw and leak a chunk
+         if (needed > m_chunks.capacity())
+            m_chunks.reserve((std::max)(needed, m_chunks.capacity() * 2));
+
+         while (m_chunks.size() < needed)
+            m_chunks.push_back(static_cast<T*>(::operator new(ChunkSize * sizeof(T))));
+      }
+
+      std::vector<T*>   m_chunks;
+      INT_PTR           m_size;
+   };
+
+   template <typename T, typename TArg, INT_PTR ChunkSize>
+   inline typename CChunkedArray<T, TArg, ChunkSize>::iterator begin(CChunkedArray<T, TArg, ChunkSize>& collection) noexcept
+   {
+      return collection.begin();
+   }
+
+   template <typename T, typename TArg, INT_PTR ChunkSize>
+   inline typename CChunkedArray<T, TArg, ChunkSize>::iterator end(CChunkedArray<T, TArg, ChunkSize>& collection) noexcept
+   {
+      return collection.end();
+   }
+
+   template <typename T, typename TArg, INT_PTR ChunkSize>
+   inline typename CChunkedArray<T, TArg, ChunkSize>::const_iterator begin(CChunkedArray<T, TArg, ChunkSize> const & collection) noexcept
+   {
+      return collection.begin();
+   }
+
+   template <typename T, typename TArg, INT_PTR ChunkSize>
+   inline typename CChunkedArray<T, TArg, ChunkSize>::const_iterator end(CChunkedArray<T, TArg, ChunkSize> const & collection) noexcept
+   {
+      return collection.end();
+   }
+}
+
+#pragma endregion
+
+#pragma region small arrays
+
+namespace mfc
+{
+   // Array with the CArray members and room for N elements inside the object. Up to N elements no memory is
+   // allocated; beyond that the elements move to the heap as in CArray. Iterators are CTypeArrayIterator's.
+   template <typename T, INT_PTR N, typename TArg = T const &>
+   class CSmallArray
+   {
+      static_assert(N > 0, "the inline capacity must not be empty");
+
+   public:
+      typedef CTypeArrayIterator<CSmallArray, T>               iterator;
+      typedef CTypeArrayIterator<CSmallArray const, T const>   const_iterator;
+
+      CSmallArray() noexcept :
+         m_data(Inline()),
+         m_size(0),
+         m_capacity(N)
+      {
+      }
+
+      CSmallArray(CSmallArray const & other) : CSmallArray()
+      {
+         Copy(other);
+      }
+
+      CSmallArray& operator=(CSmallArray const & other)
+      {
+         if (this != &other)
+            Copy(other);
+         return *this;
+      }
+
+      ~CSmallArray()
+      {
+         RemoveAll();
+      }
+
+      INT_PTR GetSize() const noexcept { return m_size; }
+      INT_PTR GetCount() const noexcept { return m_size; }
+      INT_PTR GetUpperBound() const noexcept { return m_size - 1; }
+      BOOL IsEmpty() const noexcept { return m_size == 0; }
+
+      // true while the elements are stored inside the object
+      bool IsInline() const noexcept { return m_data == Inline(); }
+
+      // nGrowBy is accepted for compatibility with CArray; the capacity doubles when it is exceeded
+      void SetSize(INT_PTR const nNewSize, INT_PTR const nGrowBy = -1)
+      {
+         UNREFERENCED_PARAMETER(nGrowBy);
+         ASSERT(nNewSize >= 0);
+
+         if (nNewSize > m_size)
+         {
+            Reserve(nNewSize);
+            while (m_size < nNewSize)
+            {
+               ::new (m_data + m_size) T();
+               ++m_size;
+            }
+         }
+         else
+         {
+            while (m_size > nNewSize)
+               m_data[--m_size].~T();
+         }
+      }
+
+      INT_PTR Add(TArg newElement)
+      {
+         if (m_size == m_capacity)
+         {
+            // newElement may refer to an element of this array
+            T copy(newElement);
+            Reserve(m_size + 1);
+            ::new (m_data + m_size) T(std::move(copy));
+         }
+         else
+         {
+            ::new (m_data + m_size) T(newElement);
+         }
+         return m_size++;
+      }
+
+      INT_PTR Append(CSmallArray const & src)
+      {
+         ASSERT(this != &src);
+         INT_PTR const oldSize = m_size;
+         Reserve(m_size + src.m_size);
+         for (INT_PTR i = 0; i < src.m_size; ++i)
+         {
+            ::new (m_data + m_size) T(src.m_data[i]);
+            ++m_size;
+         }
+         return oldSize;
+      }
+
+      void Copy(CSmallArray const & src)
+      {
+         if (this == &src)
+            return;
+
+         SetSize(0);
+         Append(src);
+      }
+
+      T const & GetAt(INT_PTR const nIndex) const
+      {
+         ASSERT(nIndex >= 0 && nIndex < m_size);
+         return m_data[nIndex];
+      }
+
+      T& GetAt(INT_PTR const nIndex)
+      {
+         ASSERT(nIndex >= 0 && nIndex < m_size);
+         return m_data[nIndex];
+      }
+
+      T& ElementAt(INT_PTR const nIndex)
+      {
+         return GetAt(nIndex);
+      }
+
+      void SetAt(INT_PTR const nIndex, TArg newElement)
+      {
+         GetAt(nIndex) = newElement;
+      }
+
+      void SetAtGrow(INT_PTR const nIndex, TArg newElement)
+      {
+         ASSERT(nIndex >= 0);
+         if (nIndex >= m_size)
+         {
+            T copy(newElement);
+            SetSize(nIndex + 1);
+            m_data[nIndex] = std::move(copy);
+         }
+         else
+         {
+            m_data[nIndex] = newElement;
+         }
+      }
+
+      T const & operator[](INT_PTR const nIndex) const
+      {
+         return GetAt(nIndex);
+      }
+
+      T& operator[](INT_PTR const nIndex)
+      {
+         return GetAt(nIndex);
+      }
+
+      T const * GetData() const noexcept { return m_data; }
+      T* GetData() noexcept { return m_data; }
+
+      void InsertAt(INT_PTR const nIndex, TArg newElement, INT_PTR const nCount = 1)
+      {
+         ASSERT(nIndex >= 0 && nCount > 0);
+
+         T copy(newElement);
+         INT_PTR const oldSize = m_size;
+         if (nIndex >= oldSize)
+         {
+            SetSize(nIndex + nCount);
+         }
+         else
+         {
+            SetSize(oldSize + nCount);
+            std::move_backward(m_data + nIndex, m_data + oldSize, m_data + oldSize + nCount);
+         }
+
+         std::fill(m_data + nIndex, m_data + nIndex + nCount, copy);
+      }
+
+      void RemoveAt(INT_PTR const nIndex, INT_PTR const nCount = 1)
+      {
+         ASSERT(nIndex >= 0 && nCount >= 0 && nIndex + nCount <= m_size);
+
+         std::move(m_data + nIndex + nCount, m_data + m_size, m_data + nIndex);
+         SetSize(m_size - nCount);
+      }
+
+      // destroys the elements and frees the heap storage, if any
+      void RemoveAll() noexcept
+      {
+         SetSize(0);
+         FreeExtra();
+      }
+
+      // moves the elements back inside the object when they fit, or shrinks the heap storage to the size
+      void FreeExtra()
+      {
+         if (IsInline() || m_capacity == (std::max)(m_size, N))
+            return;
+
+         Reallocate((std::max)(m_size, N));
+      }
+
+      iterator begin() noexcept { return iterator(*this, 0); }
+      iterator end() noexcept { return iterator(*this, m_size); }
+      const_iterator begin() const noexcept { return const_iterator(*this, 0); }
+      const_iterator end() const noexcept { return const_iterator(*this, m_size); }
+
+   private:
+      T* Inline() noexcept { return reinterpret_cast<T*>(&m_inline); }
+      T const * Inline() const noexcept { return reinterpret_cast<T const *>(&m_inline); }
+
+      void Reserve(INT_PTR const count)
+      {
+         if (count > m_capacity)
+            Reallocate((std::max)(count, m_capacity * 2));
+      }
+
+      void Reallocate(INT_PTR const capacity)
+      {
+         ASSERT(capacity >= m_size);
+
+         T* const data = capacity == N ? Inline() : static_cast<T*>(::operator new(static_cast<size_t>(capacity) * sizeof(T)));
+         INT_PTR moved = 0;
+         try
+         {
+            for (; moved < m_size; ++moved)
+               ::new (data + moved) T(std::move_if_noexcept(m_data[moved]));
+         }
+         catch (...)
+         {
+            while (moved > 0)
+               data[--moved].~T();
+            if (data != Inline())
+               ::operator delete(data);
+            throw;
+         }
+
+         for (INT_PTR i = m_size; i > 0; --i)
+            m_data[i - 1].~T();
+         if (!IsInline())
+            ::operator delete(m_data);
+
+         m_data = data;
+         m_capacity = capacity;
+      }
+
+      typename std::aligned_storage<sizeof(T) * N, alignof(T)>::type  m_inline;
+      T*                                                              m_data;
+      INT_PTR                                                         m_size;
+      INT_PTR                                                         m_capacity;
+   };
+
+   template <typename T, INT_PTR N, typename TArg>
+   inline typename CSmallArray<T, N, TArg>::iterator begin(CSmallArray<T, N, TArg>& collection) noexcept
+   {
+      return collection.begin();
+   }
+
+   template <typename T, INT_PTR N, typename TArg>
+   inline typename CSmallArray<T, N, TArg>::iterator end(CSmallArray<T, N, TArg>& collection) noexcept
+   {
+      return collection.end();
+   }
+
+   template <typename T, INT_PTR N, typename TArg>
+   inline typename CSmallArray<T, N, TArg>::const_iterator begin(CSmallArray<T, N, TArg> const & collection) noexcept
+   {
+      return collection.begin();
+   }
+
+   template <typename T, INT_PTR N, typename TArg>
+   inline typename CSmallArray<T, N, TArg>::const_iterator end(CSmallArray<T, N, TArg> const & collection) noexcept
+   {
+      return collection.end();
+   }
+}
+
+#pragma endregion
+
+#pragma region copy-on-write snapshots
+
+namespace mfc
+{
+   namespace detail
+   {
+      template <typename C>
+      auto begin_of(C const & collection) -> decltype(begin(collection))
+      {
+         return begin(collection);
+      }
+
+      template <typename C>
+      auto end_of(C const & collection) -> decltype(end(collection))
+      {
+         return end(collection);
+      }
+
+      // arrays
+      template <typename C>
+      auto copy_collection(C& target, C const & source, int) -> decltype(target.Copy(source), void())
+      {
+         target.Copy(source);
+      }
+
+      // lists
+      template <typename C>
+      auto copy_collection(C& target, C const & source, long) -> decltype(target.AddTail(*begin_of(source)), void())
+      {
+         for (auto const & element : source)
+            target.AddTail(element);
+      }
+
+      // maps
+      template <typename C>
+      auto copy_collection(C& target, C const & source, ...) -> decltype(target.SetAt((*begin_of(source)).key, (*begin_of(source)).value), void())
+      {
+         target.InitHashTable(source.GetHashTableSize());
+         for (auto const & pair : source)
+            target.SetAt(pair.key, pair.value);
+      }
+   }
+
+   // Immutable view of a collection shared with a CCopyOnWrite. Holding it keeps that version alive; it is not
+   // affected by later modifications. Iteration uses the collection's const iterators.
+   template <typename C>
+   class CSnapshot
+   {
+   public:
+      CSnapshot() = default;
+
+      explicit CSnapshot(std::shared_ptr<C const> data) noexcept : m_data(std::move(data))
+      {
+      }
+
+      C const & operator* () const noexcept { return *m_data; }
+      C const * operator-> () const noexcept { return m_data.get(); }
+
+      INT_PTR GetCount() const { return m_data->GetCount(); }
+      BOOL IsEmpty() const { return m_data->GetCount() == 0; }
+
+      auto begin() const -> decltype(detail::begin_of(std::declval<C const &>())) { return detail::begin_of(*m_data); }
+      auto end() const -> decltype(detail::end_of(std::declval<C const &>())) { return detail::end_of(*m_data); }
+
+   private:
+      std::shared_ptr<C const> m_data;
+   };
+
+   // Collection shared between threads through snapshots. Taking a snapshot only copies a shared pointer;
+   // a writer modifies the collection in place when no snapshot of the current version exists and otherwise
+   // modifies a copy that is then published, so readers never see a partial change and never pay for a copy.
+   // Works with arrays (Copy), lists (AddTail) and maps (SetAt).
+   template <typename C>
+   class CCopyOnWrite
+   {
+   public:
+      CCopyOnWrite() : m_current(std::make_shared<C>())
+      {
+      }
+
+      CCopyOnWrite(CCopyOnWrite const &) = delete;
+      CCopyOnWrite& operator=(CCopyOnWrite const &) = delete;
+
+      CSnapshot<C> Snapshot() const
+      {
+         std::lock_guard<std::mutex> lock(m_lock);
+         return CSnapshot<C>(m_current);
+      }
+
+      // calls fn(C&) with the collection to change; writers are serialized
+      template <typename Fn>
+      void Modify(Fn&& fn)
+      {
+         std::lock_guard<std::mutex> writer(m_writeLock);
+
+         std::shared_ptr<C> current;
+         {
+            std::lock_guard<std::mutex> lock(m_lock);
+
+            // no snapshot refers to this version and none can be taken while the lock is held
+            if (m_current.use_count() == 1)
+            {
+               fn(*m_current);
+               return;
+            }
+
+            current = m_current;
+         }
+
+         std::shared_ptr<C> copy = std::make_shared<C>();
+         detail::copy_collection(*copy, *current, 0);
+         current.reset();
+
+         fn(*copy);
+
+         std::lock_guard<std::mutex> lock(m_lock);
+         m_current = std::move(copy);
+      }
+
+   private:
+      mutable std::mutex   m_lock;
+      std::mutex           m_writeLock;
+      std::shared_ptr<C>   m_current;
+   };
+}
+
+#pragma endregion
+
+#pragma region published maps
+
+namespace mfc
+{
+   // Map read without locks by any number of threads (read-copy-update). Readers get the current version
+   // through an atomic pointer; writers build a new version from a copy of the current one and publish it.
+   // Replaced versions are deleted once no reader that could still see them is active (epoch-based reclamation).
+   // Works with CMap, the non-template maps and CTypedPtrMap.
+   template <typename M>
+   class CPublishedMap
+   {
+      struct reader_slot
+      {
+         std::atomic<ULONGLONG>  epoch;   // epoch pinned by an active reader, 0 if free
+         BYTE                    padding[64 - sizeof(std::atomic<ULONGLONG>)];
+      };
+
+      struct retired_version
+      {
+         M const *   map;
+         ULONGLONG   epoch;
+      };
+
+   public:
+      // Access to the version that was current when the view was created. The view pins that version; keep it
+      // short-lived, since versions replaced after it was created cannot be reclaimed until it is destroyed.
+      class CReadView
+      {
+      public:
+         CReadView(CReadView&& other) noexcept : m_slot(other.m_slot), m_map(other.m_map)
+         {
+            other.m_slot = nullptr;
+            other.m_map = nullptr;
+         }
+
+         CReadView(CReadView const &) = delete;
+         CReadView& operator=(CReadView const &) = delete;
+         CReadView& operator=(CReadView&&) = delete;
+
+         ~CReadView()
+         {
+            if (m_slot != nullptr)
+               m_slot->epoch.store(0, std::memory_order_release);
+         }
+
+         M const & operator* () const noexcept { return *m_map; }
+         M const * operator-> () const noexcept { return m_map; }
+
+         auto begin() const -> decltype(detail::begin_of(std::declval<M const &>())) { return detail::begin_of(*m_map); }
+         auto end() const -> decltype(detail::end_of(std::declval<M const &>())) { return detail::end_of(*m_map); }
+
+      private:
+         friend class CPublishedMap;
+
+         CReadView(reader_slot* slot, M const * map) noexcept : m_slot(slot), m_map(map)
+         {
+         }
+
+         reader_slot*   m_slot;
+         M const *      m_map;
+      };
+
+      explicit CPublishedMap(size_t const readerSlots = 0) :
+         m_current(new M()),
+         m_epoch(1),
+         m_slots((std::max)(readerSlots != 0 ? readerSlots : static_cast<size_t>(detail::worker_count()) * 4, static_cast<size_t>(64)))
+      {
+         for (auto& slot : m_slots)
+            slot.epoch.store(0, std::memory_order_relaxed);
+      }
+
+      CPublishedMap(CPublishedMap const &) = delete;
+      CPublishedMap& operator=(CPublishedMap const &) = delete;
+
+      // no reader may be active
+      ~CPublishedMap()
+      {
+         for (auto const & retired : m_retired)
+            delete retired.map;
+         delete m_current.load(std::memory_order_relaxed);
+      }
+
+      CReadView Read() const
+      {
+         reader_slot* const slot = Pin();
+         return CReadView(slot, m_current.load(std::memory_order_seq_cst));
+      }
+
+      // queues a change for the next Publish
+      template <typename Fn>
+      void Stage(Fn&& fn)
+      {
+         std::lock_guard<std::mutex> lock(m_writeLock);
+         m_staged.emplace_back(std::forward<Fn>(fn));
+      }
+
+      // applies the staged changes to a copy of the current version and publishes it
+      void Publish()
+      {
+         std::lock_guard<std::mutex> lock(m_writeLock);
+         if (m_staged.empty())
+            return;
+
+         std::unique_ptr<M> next(new M());
+         detail::copy_collection(*next, *m_current.load(std::memory_order_relaxed), 0);
+         for (auto& change : m_staged)
+            change(*next);
+         m_staged.clear();
+
+         Replace(next.release());
+      }
+
+      // stages fn and publishes immediately
+      template <typename Fn>
+      void Update(Fn&& fn)
+      {
+         Stage(std::forward<Fn>(fn));
+         Publish();
+      }
+
+      // number of replaced versions not reclaimed yet
+      INT_PTR GetRetiredCount() const
+      {
+         std::lock_guard<std::mutex> lock(m_writeLock);
+         return static_cast<INT_PTR>(m_retired.size());
+      }
+
+   private:
+      reader_slot* Pin() const
+      {
+         size_t index = std::hash<std::thread::id>()(std::this_thread::get_id()) % m_slots.size();
+         for (;;)
+         {
+            for (size_t i = 0; i < m_slots.size(); ++i)
+            {
+               reader_slot& slot = m_slots[(index + i) % m_slots.size()];
+               ULONGLONG expected = 0;
+               if (slot.epoch.load(std::memory_order_relaxed) == 0 &&
+                   slot.epoch.compare_exchange_strong(expected, m_epoch.load(std::memory_order_seq_cst), std::memory_order_seq_cst))
+                  return &slot;
+            }
+
+            // more concurrent readers than slots
+            std::this_thread::yield();
+         }
+      }
+
+      void Replace(M const * next)
+      {
+         M const * const previous = m_current.exchange(next, std::memory_order_seq_cst);
+
+         // readers that pinned this epoch or an earlier one may still see the previous version
+         retired_version retired = { previous, m_epoch.fetch_add(1, std::memory_order_seq_cst) };
+         m_retired.push_back(retired);
+
+         Reclaim();
+      }
+
+      void Reclaim()
+      {
+         ULONGLONG oldest = (std::numeric_limits<ULONGLONG>::max)();
+         for (auto const & slot : m_slots)
+         {
+            ULONGLONG const epoch = slot.epoch.load(std::memory_order_seq_cst);
+            if (epoch != 0 && epoch < oldest)
+               oldest = epoch;
+         }
+
+         auto const last = std::remove_if(m_retired.begin(), m_retired.end(), [oldest](retired_version const & retired) {
+            if (retired.epoch >= oldest)
+               return false;
+            delete retired.map;
+            return true;
+         });
+         m_retired.erase(last, m_retired.end());
+      }
+
+      std::atomic<M const *>                    m_current;
+      std::atomic<ULONGLONG>                    m_epoch;
+      mutable std::vector<reader_slot>          m_slots;
+
+      mutable std::mutex                        m_writeLock;
+      std::vector<std::function<void(M&)>>      m_staged;
+      std::vector<retired_version>              m_retired;
+   };
+}
+
+#pragma endregion
+
+#pragma region reader/writer-locked collections
+
+namespace mfc
+{
+   namespace detail
+   {
+#ifdef MFC_HAS_SHARED_MUTEX
+      using shared_mutex = std::shared_mutex;
+#else
+      using shared_mutex = std::shared_timed_mutex;
+#endif
+   }
+
+   // Lock statistics of a CLockedCollection. An acquisition is contended when the lock was not immediately available.
+   struct CLockStatistics
+   {
+      ULONGLONG   sharedAcquisitions;
+      ULONGLONG   sharedContended;
+      ULONGLONG   exclusiveAcquisitions;
+      ULONGLONG   exclusiveContended;
+      ULONGLONG   batches;          // exclusive acquisitions that applied queued writes
+      ULONGLONG   queuedWrites;     // queued writes applied
+   };
+
+   template <typename C>
+   class CLockedCollection;
+
+   // Range over a CLockedCollection that holds the shared lock while it exists. Iteration uses the collection's
+   // const iterators.
+   template <typename C>
+   class CLockedRange
+   {
+   public:
+      CLockedRange(CLockedRange&&) = default;
+      CLockedRange(CLockedRange const &) = delete;
+      CLockedRange& operator=(CLockedRange const &) = delete;
+
+      C const & operator* () const noexcept { return *m_data; }
+      C const * operator-> () const noexcept { return m_data; }
+
+      INT_PTR GetCount() const { return m_data->GetCount(); }
+      BOOL IsEmpty() const { return m_data->GetCount() == 0; }
+
+      auto begin() const -> decltype(detail::begin_of(std::declval<C const &>())) { return detail::begin_of(*m_data); }
+      auto end() const -> decltype(detail::end_of(std::declval<C const &>())) { return detail::end_of(*m_data); }
+
+   private:
+      friend class CLockedCollection<C>;
+
+      CLockedRange(std::shared_lock<detail::shared_mutex>&& lock, C const * data) noexcept :
+         m_lock(std::move(lock)), m_data(data)
+      {
+      }
+
+      std::shared_lock<detail::shared_mutex>   m_lock;
+      C const *                                m_data;
+   };
+
+   // Array, list or map shared between threads behind a shared/exclusive lock. Readers lock shared and do not
+   // block each other. Writes either run immediately under the exclusive lock (Write) or are queued (Queue) and
+   // applied in batches, several writes per exclusive acquisition. Queued writes are applied in the order
+   // they were queued and always before a later immediate write.
+   template <typename C>
+   class CLockedCollection
+   {
+   public:
+      static INT_PTR const DefaultBatchSize = 64;
+
+      explicit CLockedCollection(INT_PTR const batchSize = DefaultBatchSize) :
+         m_batchSize(batchSize)
+      {
+         ResetStatistics();
+      }
+
+      CLockedCollection(CLockedCollection const &) = delete;
+      CLockedCollection& operator=(CLockedCollection const &) = delete;
+
+      // Read access for as long as the returned range exists. Writes queued but not applied yet are not visible.
+      CLockedRange<C> Read() const
+      {
+         std::shared_lock<detail::shared_mutex> lock(m_lock, std::try_to_lock);
+         if (!lock.owns_lock())
+         {
+            m_sharedContended.fetch_add(1, std::memory_order_relaxed);
+            lock.lock();
+         }
+         m_sharedAcquisitions.fetch_add(1, std::memory_order_relaxed);
+
+         return CLockedRange<C>(std::move(lock), &m_data);
+      }
+
+      // calls fn(C const &) under the shared lock
+      template <typename Fn>
+      auto Read(Fn&& fn) const -> decltype(fn(std::declval<C const &>()))
+      {
+         auto const range = Read();
+         return fn(*range);
+      }
+
+      // applies the queued writes, then calls fn(C&) under the exclusive lock
+      template <typename Fn>
+      auto Write(Fn&& fn) -> decltype(fn(std::declval<C&>()))
+      {
+         auto lock = LockExclusive();
+         ApplyQueued();
+         return fn(m_data);
+      }
+
+      // Queues fn(C&). Once the batch size is reached, the calling thread applies the queued writes.
+      template <typename Fn>
+      void Queue(Fn&& fn)
+      {
+         INT_PTR pending = 0;
+         {
+            std::lock_guard<std::mutex> lock(m_queueLock);
+            m_queue.emplace_back(std::forward<Fn>(fn));
+            pending = static_cast<INT_PTR>(m_queue.size());
+         }
+
+         if (pending >= m_batchSize)
+            Flush();
+      }
+
+      // applies the queued writes under one exclusive acquisition
+      void Flush()
+      {
+         auto lock = LockExclusive();
+         ApplyQueued();
+      }
+
+      INT_PTR GetQueuedCount() const
+      {
+         std::lock_guard<std::mutex> lock(m_queueLock);
+         return static_cast<INT_PTR>(m_queue.size());
+      }
+
+      CLockStatistics GetStatistics() const noexcept
+      {
+         CLockStatistics statistics;
+         statistics.sharedAcquisitions = m_sharedAcquisitions.load(std::memory_order_relaxed);
+         statistics.sharedContended = m_sharedContended.load(std::memory_order_relaxed);
+         statistics.exclusiveAcquisitions = m_exclusiveAcquisitions.load(std::memory_order_relaxed);
+         statistics.exclusiveContended = m_exclusiveContended.load(std::memory_order_relaxed);
+         statistics.batches = m_batches.load(std::memory_order_relaxed);
+         statistics.queuedWrites = m_queuedWrites.load(std::memory_order_relaxed);
+         return statistics;
+      }
+
+      void ResetStatistics() noexcept
+      {
+         m_sharedAcquisitions.store(0, std::memory_order_relaxed);
+         m_sharedContended.store(0, std::memory_order_relaxed);
+         m_exclusiveAcquisitions.store(0, std::memory_order_relaxed);
+         m_exclusiveContended.store(0, std::memory_order_relaxed);
+         m_batches.store(0, std::memory_order_relaxed);
+         m_queuedWrites.store(0, std::memory_order_relaxed);
+      }
+
+   private:
+      std::unique_lock<detail::shared_mutex> LockExclusive()
+      {
+         std::unique_lock<detail::shared_mutex> lock(m_lock, std::try_to_lock);
+         if (!lock.owns_lock())
+         {
+            m_exclusiveContended.fetch_add(1, std::memory_order_relaxed);
+            lock.lock();
+         }
+         m_exclusiveAcquisitions.fetch_add(1, std::memory_order_relaxed);
+         return lock;
+      }
+
+      // exclusive lock held
+      void ApplyQueued()
+      {
+         std::vector<std::function<void(C&)>> batch;
+         {
+            std::lock_guard<std::mutex> lock(m_queueLock);
+            batch.swap(m_queue);
+         }
+
+         if (batch.empty())
+            return;
+
+         for (auto& write : batch)
+            write(m_data);
+
+         m_batches.fetch_add(1, std::memory_order_relaxed);
+         m_queuedWrites.fetch_add(batch.size(), std::memory_order_relaxed);
+      }
+
+      C                                      m_data;
+      mutable detail::shared_mutex           m_lock;
+      INT_PTR const                          m_batchSize;
+
+      mutable std::mutex                     m_queueLock;
+      std::vector<std::function<void(C&)>>   m_queue;
+
+      mutable std::atomic<ULONGLONG>         m_sharedAcquisitions;
+      mutable std::atomic<ULONGLONG>         m_sharedContended;
+      std::atomic<ULONGLONG>                 m_exclusiveAcquisitions;
+      std::atomic<ULONGLONG>                 m_exclusiveContended;
+      std::atomic<ULONGLONG>                 m_batches;
+      std::atomic<ULONGLONG>                 m_queuedWrites;
+   };
+}
+
+#pragma endregion
+
+#pragma region ring buffers
+
+namespace mfc
+{
+   namespace detail
+   {
+      inline size_t ring_capacity(size_t const requested) noexcept
+      {
+         size_t capacity = 2;
+         while (capacity < requested)
+            capacity <<= 1;
+         return capacity;
+      }
+   }
+
+   // Elements taken from a ring buffer by its consumer in one step. The elements stay in the ring's storage
+   // and are released when the batch is destroyed (or on Release), which frees their slots for the producers.
+   // Random-access: iterators are CTypeArrayIterators, so the array algorithms apply.
+   template <typename R>
+   class CRingBatch
+   {
+   public:
+      typedef typename R::value_type                                 value_type;
+      typedef CTypeArrayIterator<CRingBatch, value_type>             iterator;
+      typedef CTypeArrayIterator<CRingBatch const, value_type const> const_iterator;
+
+      CRingBatch(CRingBatch&& other) noexcept : m_ring(other.m_ring), m_first(other.m_first), m_count(other.m_count)
+      {
+         other.m_ring = nullptr;
+      }
+
+      CRingBatch(CRingBatch const &) = delete;
+      CRingBatch& operator=(CRingBatch const &) = delete;
+      CRingBatch& operator=(CRingBatch&&) = delete;
+
+      ~CRingBatch()
+      {
+         Release();
+      }
+
+      INT_PTR GetSize() const noexcept { return m_ring != nullptr ? m_count : 0; }
+      INT_PTR GetCount() const noexcept { return GetSize(); }
+      BOOL IsEmpty() const noexcept { return GetSize() == 0; }
+
+      value_type& operator[](INT_PTR const index)
+      {
+         ASSERT(index >= 0 && index < GetSize());
+         return m_ring->Element(m_first + static_cast<size_t>(index));
+      }
+
+      value_type const & operator[](INT_PTR const index) const
+      {
+         ASSERT(index >= 0 && index < GetSize());
+         return m_ring->Element(m_first + static_cast<size_t>(index));
+      }
+
+      iterator begin() noexcept { return iterator(*this, 0); }
+      iterator end() noexcept { return iterator(*this, GetSize()); }
+      const_iterator begin() const noexcept { return const_iterator(*this, 0); }
+      const_iterator end() const noexcept { return const_iterator(*this, GetSize()); }
+
+      // destroys the elements and hands their slots back to the ring
+      void Release()
+      {
+         if (m_ring != nullptr)
+         {
+            m_ring->Release(m_first, m_count);
+            m_ring = nullptr;
+         }
+      }
+
+   private:
+      friend R;
+
+      CRingBatch(R* ring, size_t const first, INT_PTR const count) noexcept : m_ring(ring), m_first(first), m_count(count)
+      {
+      }
+
+      R*       m_ring;
+      size_t   m_first;
+      INT_PTR  m_count;
+   };
+
+   template <typename R>
+   inline typename CRingBatch<R>::iterator begin(CRingBatch<R>& batch) noexcept
+   {
+      return batch.begin();
+   }
+
+   template <typename R>
+   inline typename CRingBatch<R>::iterator end(CRingBatch<R>& batch) noexcept
+   {
+      return batch.end();
+   }
+
+   template <typename R>
+   inline typename CRingBatch<R>::const_iterator begin(CRingBatch<R> const & batch) noexcept
+   {
+      return batch.begin();
+   }
+
+   template <typename R>
+   inline typename CRingBatch<R>::const_iterator end(CRingBatch<R> const & batch) noexcept
+   {
+      return batch.end();
+   }
+
+   // Bounded lock-free queue for one producer thread and one consumer thread. The capacity is rounded up to
+   // a power of two and allocated once; pushing and popping never allocate.
+   template <typename T>
+   class CSpscRing
+   {
+      typedef typename std::aligned_storage<sizeof(T), alignof(T)>::type slot;
+
+   public:
+      typedef T                     value_type;
+      typedef CRingBatch<CSpscRing> batch;
+
+      explicit CSpscRing(size_t const capacity) :
+         m_slots(new slot[detail::ring_capacity(capacity)]),
+         m_mask(detail::ring_capacity(capacity) - 1),
+         m_head(0),
+         m_cachedTail(0),
+         m_draining(false),
+         m_tail(0),
+         m_cachedHead(0)
+      {
+      }
+
+      CSpscRing(CSpscRing const &) = delete;
+      CSpscRing& operator=(CSpscRing const &) = delete;
+
+      ~CSpscRing()
+      {
+         size_t const tail = m_tail.load(std::memory_order_relaxed);
+         for (size_t head = m_head.load(std::memory_order_relaxed); head != tail; ++head)
+            Element(head).~T();
+      }
+
+      size_t GetCapacity() const noexcept { return m_mask + 1; }
+
+      // number of elements, exact only when neither side is active
+      INT_PTR GetCount() const noexcept
+      {
+         return static_cast<INT_PTR>(m_tail.load(std::memory_order_acquire) - m_head.load(std::memory_order_acquire));
+      }
+
+      // producer: returns FALSE if the ring is full
+      BOOL TryPush(T const & value) { return Emplace(value); }
+      BOOL TryPush(T&& value) { return Emplace(std::move(value)); }
+
+      // producer: waits while the ring is full
+      void Push(T const & value)
+      {
+         while (!Emplace(value))
+            std::this_thread::yield();
+      }
+
+      void Push(T&& value)
+      {
+         while (!Emplace(std::move(value)))
+            std::this_thread::yield();
+      }
+
+      // consumer: returns FALSE if the ring is empty or a drained batch has not been released yet
+      BOOL TryPop(T& value)
+      {
+         if (m_draining)
+            return FALSE;
+
+         size_t const head = m_head.load(std::memory_order_relaxed);
+         if (head == m_cachedTail)
+         {
+            m_cachedTail = m_tail.load(std::memory_order_acquire);
+            if (head == m_cachedTail)
+               return FALSE;
+         }
+
+         T& element = Element(head);
+         value = std::move(element);
+         element.~T();
+         m_head.store(head + 1, std::memory_order_release);
+         return TRUE;
+      }
+
+      // consumer: takes up to maxCount of the elements available now; while the batch is alive, Drain returns
+      // an empty batch and TryPop fails
+      batch Drain(INT_PTR const maxCount = (std::numeric_limits<INT_PTR>::max)())
+      {
+         if (m_draining)
+            return batch(nullptr, 0, 0);
+
+         size_t const head = m_head.load(std::memory_order_relaxed);
+         m_cachedTail = m_tail.load(std::memory_order_acquire);
+         size_t const available = m_cachedTail - head;
+         m_draining = true;
+         return batch(this, head, static_cast<INT_PTR>((std::min)(available, static_cast<size_t>(maxCount))));
+      }
+
+   private:
+      friend class CRingBatch<CSpscRing>;
+
+      template <typename V>
+      BOOL Emplace(V&& value)
+      {
+         size_t const tail = m_tail.load(std::memory_order_relaxed);
+         if (tail - m_cachedHead > m_mask)
+         {
+            m_cachedHead = m_head.load(std::memory_order_acquire);
+            if (tail - m_cachedHead > m_mask)
+               return FALSE;
+         }
+
+         new (&m_slots[tail & m_mask]) T(std::forward<V>(value));
+         m_tail.store(tail + 1, std::memory_order_release);
+         return TRUE;
+      }
+
+      T& Element(size_t const position) const noexcept
+      {
+         return *reinterpret_cast<T*>(&m_slots[position & m_mask]);
+      }
+
+      void Release(size_t const first, INT_PTR const count)
+      {
+         for (INT_PTR i = 0; i < count; ++i)
+            Element(first + static_cast<size_t>(i)).~T();
+         m_head.store(first + static_cast<size_t>(count), std::memory_order_release);
+         m_draining = false;
+      }
+
+      std::unique_ptr<slot[]> m_slots;
+      size_t const            m_mask;
+
+      // consumer side and producer side on separate cache lines
+      BYTE                    m_padding0[64];
+      std::atomic<size_t>     m_head;
+      size_t                  m_cachedTail;
+      bool                    m_draining;    // a batch is outstanding
+      BYTE                    m_padding1[64];
+      std::atomic<size_t>     m_tail;
+      size_t                  m_cachedHead;
+      BYTE                    m_padding2[64];
+   };
+
+   // Bounded lock-free queue for any number of producer threads and one consumer thread. Every slot carries a
+   // sequence number that tells producers and the consumer whether it is free or filled, so producers only
+   // contend on the tail counter.
+   template <typename T>
+   class CMpscRing
+   {
+      struct slot
+      {
+         std::atomic<size_t>                                      sequence;
+         typename std::aligned_storage<sizeof(T), alignof(T)>::type  value;
+      };
+
+   public:
+      typedef T                     value_type;
+      typedef CRingBatch<CMpscRing> batch;
+
+      explicit CMpscRing(size_t const capacity) :
+         m_slots(new slot[detail::ring_capacity(capacity)]),
+         m_mask(detail::ring_capacity(capacity) - 1),
+         m_head(0),
+         m_draining(false),
+         m_tail(0)
+      {
+         for (size_t i = 0; i <= m_mask; ++i)
+            m_slots[i].sequence.store(i, std::memory_order_relaxed);
+      }
+
+      CMpscRing(CMpscRing const &) = delete;
+      CMpscRing& operator=(CMpscRing const &) = delete;
+
+      ~CMpscRing()
+      {
+         for (size_t head = m_head; IsFilled(head); ++head)
+            Element(head).~T();
+      }
+
+      size_t GetCapacity() const noexcept { return m_mask + 1; }
+
+      // producers: return FALSE if the ring is full
+      BOOL TryPush(T const & value) { return Emplace(value); }
+      BOOL TryPush(T&& value) { return Emplace(std::move(value)); }
+
+      // producers: wait while the ring is full
+      void Push(T const & value)
+      {
+         while (!Emplace(value))
+            std::this_thread::yield();
+      }
+
+      void Push(T&& value)
+      {
+         while (!Emplace(std::move(value)))
+            std::this_thread::yield();
+      }
+
+      // consumer: returns FALSE if the ring is empty, the next element is still being written or a drained
+      // batch has not been released yet
+      BOOL TryPop(T& value)
+      {
+         if (m_draining || !IsFilled(m_head))
+            return FALSE;
+
+         T& element = Element(m_head);
+         value = std::move(element);
+         element.~T();
+         m_slots[m_head & m_mask].sequence.store(m_head + m_mask + 1, std::memory_order_release);
+         ++m_head;
+         return TRUE;
+      }
+
+      // consumer: takes up to maxCount of the consecutive elements filled now; while the batch is alive, Drain
+      // returns an empty batch and TryPop fails
+      batch Drain(INT_PTR const maxCount = (std::numeric_limits<INT_PTR>::max)())
+      {
+         if (m_draining)
+            return batch(nullptr, 0, 0);
+
+         INT_PTR count = 0;
+         while (count < maxCount && count <= static_cast<INT_PTR>(m_mask) && IsFilled(m_head + static_cast<size_t>(count)))
+            ++count;
+         m_draining = true;
+         return batch(this, m_head, count);
+      }
+
+   private:
+      friend class CRingBatch<CMpscRing>;
+
+      template <typename V>
+      BOOL Emplace(V&& value)
+      {
+         size_t position = m_tail.load(std::memory_order_relaxed);
+         for (;;)
+         {
+            slot& target = m_slots[position & m_mask];
+            auto const difference = static_cast<ptrdiff_t>(target.sequence.load(std::memory_order_acquire) - position);
+            if (difference == 0)
+            {
+               if (m_tail.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+               {
+                  new (&target.value) T(std::forward<V>(value));
+                  target.sequence.store(position + 1, std::memory_order_release);
+                  return TRUE;
+               }
+            }
+            else if (difference < 0)
+            {
+               // the slot still holds an element from the previous lap
+               return FALSE;
+            }
+            else
+            {
+               position = m_tail.load(std::memory_order_relaxed);
+            }
+         }
+      }
+
+      BOOL IsFilled(size_t const position) const noexcept
+      {
+         return m_slots[position & m_mask].sequence.load(std::memory_order_acquire) == position + 1;
+      }
+
+      T& Element(size_t const position) const noexcept
+      {
+         return *reinterpret_cast<T*>(&m_slots[position & m_mask].value);
+      }
+
+      void Release(size_t const first, INT_PTR const count)
+      {
+         for (size_t position = first; position != first + static_cast<size_t>(count); ++position)
+         {
+            Element(position).~T();
+            m_slots[position & m_mask].sequence.store(position + m_mask + 1, std::memory_order_release);
+         }
+         m_head = first + static_cast<size_t>(count);
+         m_draining = false;
+      }
+
+      std::unique_ptr<slot[]> m_slots;
+      size_t const            m_mask;
+
+      BYTE                    m_padding0[64];
+      size_t                  m_head;        // consumer only
+      bool                    m_draining;    // consumer only, a batch is outstanding
+      BYTE                    m_padding1[64];
+      std::atomic<size_t>     m_tail;
+      BYTE                    m_padding2[64];
+   };
+}
+
+#pragma endregion
+
+#pragma region flat list views
+
+namespace mfc
+{
+   namespace detail
+   {
+      // what a flat list view stores for an element: a copy, or a pointer to the element in the list
+      template <typename T, bool Pointers>
+      struct flat_slot
+      {
+         typedef T type;
+         static T const & get(T const & slot) noexcept { return slot; }
+         static T const & make(T const & element) noexcept { return element; }
+      };
+
+      template <typename T>
+      struct flat_slot<T, true>
+      {
+         typedef T const * type;
+         static T const & get(T const * slot) noexcept { return *slot; }
+         static T const * make(T const & element) noexcept { return &element; }
+      };
+   }
+
+   // Contiguous copy of the elements of a CList, CTypedPtrList, CPtrList, CObList or CStringList for lists
+   // that are scanned much more often than they change. Scans run over an array instead of chasing node
+   // pointers and the elements can be accessed by index. With Pointers, the view stores pointers to the
+   // elements in the list instead of copies, for elements that are large or expensive to copy. The buffer is
+   // rebuilt when the element count changes or when an optional version token supplied by the caller changes;
+   // call Invalidate after changes that keep the count when no token is used.
+   template <typename L, bool Pointers = false>
+   class CFlatListView
+   {
+   public:
+      typedef typename std::decay<decltype(std::declval<L const &>().GetNext(std::declval<POSITION&>()))>::type value_type;
+
+   private:
+      typedef detail::flat_slot<value_type, Pointers>  slot_traits;
+      typedef typename slot_traits::type               slot_type;
+
+      static_assert(!Pointers || std::is_reference<decltype(std::declval<L const &>().GetNext(std::declval<POSITION&>()))>::value,
+         "the list returns its elements by value, so there is nothing to point to");
+
+   public:
+      // Refers to the buffer by position. The end iterator resolves to the size of the buffer when it is used,
+      // so it stays consistent with a begin iterator obtained after it, even if begin() rebuilt the buffer.
+      class iterator
+      {
+      public:
+         typedef iterator                          self_type;
+         typedef typename CFlatListView::value_type value_type;
+         typedef value_type const &                reference;
+         typedef value_type const *                pointer;
+         typedef std::random_access_iterator_tag   iterator_category;
+         typedef ptrdiff_t                         difference_type;
+
+         iterator() = default;
+
+         explicit iterator(std::vector<slot_type> const & elements, difference_type const pos, bool const end) noexcept :
+            m_pos(pos),
+            m_end(end),
+            m_elements(&elements)
+         {}
+
+         bool operator== (self_type const & other) const noexcept { return Position() == other.Position(); }
+         bool operator!= (self_type const & other) const noexcept { return Position() != other.Position(); }
+         bool operator< (self_type const & other) const noexcept { return Position() < other.Position(); }
+         bool operator> (self_type const & other) const noexcept { return other.Position() < Position(); }
+         bool operator<= (self_type const & other) const noexcept { return !(other.Position() < Position()); }
+         bool operator>= (self_type const & other) const noexcept { return !(Position() < other.Position()); }
+
+         reference operator* () const { return slot_traits::get((*m_elements)[static_cast<size_t>(Position())]); }
+         pointer operator-> () const { return &**this; }
+         reference operator[](difference_type const offset) const { return slot_traits::get((*m_elements)[static_cast<size_t>(Position() + offset)]); }
+
+         self_type& operator++ () noexcept { Resolve(); ++m_pos; return *this; }
+         self_type operator++ (int) noexcept { self_type tmp = *this; ++*this; return tmp; }
+         self_type& operator-- () noexcept { Resolve(); --m_pos; return *this; }
+         self_type operator-- (int) noexcept { self_type tmp = *this; --*this; return tmp; }
+         self_type& operator+= (difference_type const offset) noexcept { Resolve(); m_pos += offset; return *this; }
+         self_type& operator-= (difference_type const offset) noexcept { Resolve(); m_pos -= offset; return *this; }
+         self_type operator+ (difference_type const offset) const noexcept { self_type tmp = *this; return tmp += offset; }
+         self_type operator- (difference_type const offset) const noexcept { self_type tmp = *this; return tmp -= offset; }
+         difference_type operator- (self_type const & other) const noexcept { return Position() - other.Position(); }
+
+      private:
+         difference_type Position() const noexcept
+         {
+            return m_end ? static_cast<difference_type>(m_elements->size()) : m_pos;
+         }
+
+         void Resolve() noexcept
+         {
+            m_pos = Position();
+            m_end = false;
+         }
+
+         difference_type                  m_pos = 0;
+         bool                             m_end = false;
+         std::vector<slot_type> const *   m_elements = nullptr;
+      };
+
+      typedef iterator const_iterator;
+
+      explicit CFlatListView(L const & list, ULONGLONG const * version = nullptr) :
+         m_list(list),
+         m_version(version)
+      {}
+
+      // the buffer is brought up to date here, once per traversal
+      iterator begin() const
+      {
+         Refresh();
+         return iterator(m_elements, 0, false);
+      }
+
+      iterator end() const
+      {
+         return iterator(m_elements, 0, true);
+      }
+
+      INT_PTR GetCount() const
+      {
+         Refresh();
+         return static_cast<INT_PTR>(m_elements.size());
+      }
+
+      BOOL IsEmpty() const
+      {
+         return GetCount() == 0;
+      }
+
+      value_type const & operator[](INT_PTR const index) const
+      {
+         Refresh();
+         ASSERT(index >= 0 && index < static_cast<INT_PTR>(m_elements.size()));
+         return slot_traits::get(m_elements[static_cast<size_t>(index)]);
+      }
+
+      // the copies, or with Pointers the pointers to the elements
+      slot_type const * GetData() const
+      {
+         Refresh();
+         return m_elements.data();
+      }
+
+      void Invalidate() noexcept
+      {
+         m_valid = false;
+      }
+
+      // rebuilds the buffer if the list changed; returns true if it did
+      bool Refresh() const
+      {
+         ULONGLONG const version = m_version != nullptr ? *m_version : 0;
+         if (m_valid && m_count == m_list.GetCount() && m_builtVersion == version)
+            return false;
+
+         // assigning over the previous elements reuses their buffers (CString, nested arrays); only the
+         // elements past the previous size are constructed, so value_type needs no default constructor
+         m_elements.reserve(static_cast<size_t>(m_list.GetCount()));
+         size_t index = 0;
+         for (POSITION pos = m_list.GetHeadPosition(); pos != nullptr; ++index)
+         {
+            auto&& element = m_list.GetNext(pos);
+            if (index < m_elements.size())
+               m_elements[index] = slot_traits::make(element);
+            else
+               m_elements.push_back(slot_traits::make(element));
+         }
+         m_elements.erase(m_elements.begin() + static_cast<ptrdiff_t>(index), m_elements.end());
+
+         m_count = m_list.GetCount();
+         m_builtVersion = version;
+         m_valid = true;
+         return true;
+      }
+
+   private:
+      L const &                        m_list;
+      ULONGLONG const *                m_version;
+      mutable std::vector<slot_type>   m_elements;
+      mutable INT_PTR                  m_count = 0;
+      mutable ULONGLONG                m_builtVersion = 0;
+      mutable bool                     m_valid = false;
+   };
+
+   template <typename L>
+   inline CFlatListView<L> flat_view(L const & list)
+   {
+      return CFlatListView<L>(list);
+   }
+
+   template <typename L>
+   inline CFlatListView<L> flat_view(L const & list, ULONGLONG const & version)
+   {
+      return CFlatListView<L>(list, &version);
+   }
+
+   // the view keeps the address of the version token, so it must not be a temporary
+   template <typename L>
+   CFlatListView<L> flat_view(L const & list, ULONGLONG const && version) = delete;
+
+   // e.g. for (CSample const & sample : mfc::flat_pointer_view(samples)) ...
+   template <typename L>
+   inline CFlatListView<L, true> flat_pointer_view(L const & list)
+   {
+      return CFlatListView<L, true>(list);
+   }
+
+   template <typename L>
+   inline CFlatListView<L, true> flat_pointer_view(L const & list, ULONGLONG const & version)
+   {
+      return CFlatListView<L, true>(list, &version);
+   }
+
+   template <typename L>
+   CFlatListView<L, true> flat_pointer_view(L const & list, ULONGLONG const && version) = delete;
+}
+
+#pragma endregion
@@ -0,0 +1,480 @@
+#include "pch.h"
+#include "CppUnitTest.h"
+#include "..\..\include\mfciterators.h"
+#include "IntObject.h"
+
+#include "Specializations.h"  // last include
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+namespace IteratorTests
+{
+   TEST_CLASS(ContainerTests)
+   {
+   private:
+      TEST_METHOD(TestChunkedArray_Add)
+      {
+         mfc::CChunkedArray<int, int, 16> arr;
+         Assert::IsTrue(arr.IsEmpty() != FALSE);
+
+         for (int i = 0; i < 100; ++i)
+            Assert::AreEqual(static_cast<INT_PTR>(i), arr.Add(i));
+
+         int* const first = &arr[0];
+         for (int i = 100; i < 1000; ++i)
+            arr.Add(i);
+
+         Assert::IsTrue(first == &arr[0]);
+         Assert::AreEqual(static_cast<INT_PTR>(1000), arr.GetSize());
+         Assert::AreEqual(999, arr.GetAt(999));
+
+         arr.SetAt(10, -10);
+         arr[11] = -11;
+         Assert::AreEqual(-10, arr[10]);
+         Assert::AreEqual(-11, arr.ElementAt(11));
+      }
+
+      TEST_METHOD(TestChunkedArray_SetSize)
+      {
+         mfc::CChunkedArray<CString, LPCTSTR, 4> arr;
+         arr.SetSize(10);
+         Assert::AreEqual(static_cast<INT_PTR>(10), arr.GetSize());
+         Assert::IsTrue(arr[9].IsEmpty());
+
+         arr.SetAtGrow(12, _T("last"));
+         Assert::AreEqual(static_cast<INT_PTR>(13), arr.GetSize());
+         Assert::IsTrue(arr[12] == _T("last"));
+
+         arr.SetSize(2);
+         arr.FreeExtra();
+         Assert::AreEqual(static_cast<INT_PTR>(2), arr.GetSize());
+
+         arr.RemoveAll();
+         Assert::IsTrue(arr.IsEmpty() != FALSE);
+      }
+
+      TEST_METHOD(TestChunkedArray_Iterators)
+      {
+         mfc::CChunkedArray<int, int, 8> arr;
+         for (int i = 0; i < 50; ++i)
+            arr.Add(49 - i);
+
+         std::sort(begin(arr), end(arr));
+         Assert::IsTrue(std::is_sorted(begin(arr), end(arr)));
+
+         mfc::CChunkedArray<int, int, 8> const & carr = arr;
+         auto pos = std::lower_bound(begin(carr), end(carr), 20);
+         Assert::AreEqual(static_cast<ptrdiff_t>(20), pos - begin(carr));
+
+         int sum = 0;
+         for (int value : carr)
+            sum += value;
+         Assert::AreEqual(49 * 50 / 2, sum);
+      }
+
+      TEST_METHOD(TestSmallArray_Inline)
+      {
+         mfc::CSmallArray<DWORD, 4> arr;
+         for (DWORD i = 0; i < 4; ++i)
+            arr.Add(i);
+
+         Assert::IsTrue(arr.IsInline());
+         Assert::AreEqual(static_cast<INT_PTR>(4), arr.GetSize());
+
+         arr.Add(arr[0]);
+         Assert::IsFalse(arr.IsInline());
+         Assert::AreEqual(static_cast<DWORD>(0), arr[4]);
+
+         arr.RemoveAt(0, 2);
+         arr.FreeExtra();
+         Assert::IsTrue(arr.IsInline());
+         Assert::AreEqual(static_cast<DWORD>(2), arr[0]);
+         Assert::AreEqual(static_cast<INT_PTR>(3), arr.GetSize());
+      }
+
+      TEST_METHOD(TestSmallArray_Strings)
+      {
+         mfc::CSmallArray<CString, 2, LPCTSTR> arr;
+         arr.Add(_T("b"));
+         arr.InsertAt(0, _T("a"));
+         arr.InsertAt(2, _T("d"));
+         arr.InsertAt(2, _T("c"));
+         arr.SetAtGrow(5, _T("f"));
+
+         Assert::AreEqual(static_cast<INT_PTR>(6), arr.GetSize());
+         Assert::IsTrue(mfc::join(arr, _T("")) == _T("abcdf"));
+
+         mfc::CSmallArray<CString, 2, LPCTSTR> copy(arr);
+         arr.RemoveAll();
+         Assert::IsTrue(arr.IsEmpty() != FALSE);
+         Assert::IsTrue(arr.IsInline());
+         Assert::IsTrue(copy[3] == _T("d"));
+      }
+
+      TEST_METHOD(TestSmallArray_Algorithms)
+      {
+         mfc::CSmallArray<int, 16> arr;
+         for (int i = 0; i < 10; ++i)
+            arr.Add((i * 7) % 10);
+
+         std::sort(begin(arr), end(arr));
+         Assert::IsTrue(std::is_sorted(begin(arr), end(arr)));
+
+         mfc::CSmallArray<int, 16> const & carr = arr;
+         Assert::IsTrue(std::binary_search(begin(carr), end(carr), 7));
+         Assert::AreEqual(45, std::accumulate(begin(carr), end(carr), 0));
+      }
+
+      TEST_METHOD(TestCopyOnWrite_Array)
+      {
+         mfc::CCopyOnWrite<CArray<int>> shared;
+         shared.Modify([](CArray<int>& arr) { for (int i = 0; i < 10; ++i) arr.Add(i); });
+
+         auto before = shared.Snapshot();
+         CArray<int> const * const original = &*before;
+
+         shared.Modify([](CArray<int>& arr) { arr.Add(10); });
+
+         auto after = shared.Snapshot();
+         Assert::AreEqual(static_cast<INT_PTR>(10), before.GetCount());
+         Assert::AreEqual(static_cast<INT_PTR>(11), after.GetCount());
+         Assert::AreEqual(45, std::accumulate(before.begin(), before.end(), 0));
+         Assert::IsTrue(&*after != original);
+
+         // without outstanding snapshots the collection is changed in place
+         CArray<int> const * const current = &*after;
+         after = mfc::CSnapshot<CArray<int>>();
+         shared.Modify([](CArray<int>& arr) { arr.Add(11); });
+         Assert::IsTrue(&*shared.Snapshot() == current);
+         Assert::AreEqual(static_cast<INT_PTR>(12), shared.Snapshot().GetCount());
+      }
+
+      TEST_METHOD(TestCopyOnWrite_ListAndMap)
+      {
+         mfc::CCopyOnWrite<CStringList> list;
+         list.Modify([](CStringList& l) { l.AddTail(_T("a")); l.AddTail(_T("b")); });
+         auto names = list.Snapshot();
+         list.Modify([](CStringList& l) { l.RemoveHead(); });
+
+         Assert::IsTrue(mfc::join(*names, _T(",")) == _T("a,b"));
+         Assert::IsTrue(mfc::join(*list.Snapshot(), _T(",")) == _T("b"));
+
+         mfc::CCopyOnWrite<CMap<int, int, int, int>> map;
+         map.Modify([](CMap<int, int, int, int>& m) { m.SetAt(1, 10); m.SetAt(2, 20); });
+         auto values = map.Snapshot();
+         map.Modify([](CMap<int, int, int, int>& m) { m.SetAt(1, 11); });
+
+         int value = 0;
+         Assert::IsTrue(values->Lookup(1, value) != FALSE);
+         Assert::AreEqual(10, value);
+         Assert::IsTrue(map.Snapshot()->Lookup(1, value) != FALSE);
+         Assert::AreEqual(11, value);
+         Assert::AreEqual(static_cast<INT_PTR>(2), map.Snapshot().GetCount());
+
+         int sum = 0;
+         for (auto const & pair : values)
+            sum += pair.value;
+         Assert::AreEqual(30, sum);
+      }
+
+      TEST_METHOD(TestCopyOnWrite_Threads)
+      {
+         mfc::CCopyOnWrite<CArray<int>> shared;
+         shared.Modify([](CArray<int>& arr) { arr.SetSize(100); });
+
+         std::atomic<bool> consistent(true);
+         std::thread reader([&]() {
+            for (int i = 0; i < 200; ++i)
+            {
+               auto snapshot = shared.Snapshot();
+               int const first = snapshot->GetAt(0);
+               for (int value : snapshot)
+                  if (value != first) consistent = false;
+            }
+         });
+
+         for (int i = 1; i <= 200; ++i)
+            shared.Modify([i](CArray<int>& arr) { for (auto& value : arr) value = i; });
+
+         reader.join();
+         Assert::IsTrue(consistent.load());
+      }
+
+      TEST_METHOD(TestPublishedMap_StageAndPublish)
+      {
+         mfc::CPublishedMap<CMap<int, int, int, int>> published;
+         published.Update([](CMap<int, int, int, int>& m) { m.SetAt(1, 10); m.SetAt(2, 20); });
+
+         auto before = published.Read();
+         published.Stage([](CMap<int, int, int, int>& m) { m.SetAt(1, 11); });
+         published.Stage([](CMap<int, int, int, int>& m) { m.RemoveKey(2); });
+
+         // staged changes are invisible until published
+         Assert::AreEqual(static_cast<INT_PTR>(2), published.Read()->GetCount());
+         published.Publish();
+
+         int value = 0;
+         Assert::IsTrue(before->Lookup(1, value) != FALSE);
+         Assert::AreEqual(10, value);
+         Assert::AreEqual(static_cast<INT_PTR>(2), before->GetCount());
+
+         auto after = published.Read();
+         Assert::IsTrue(after->Lookup(1, value) != FALSE);
+         Assert::AreEqual(11, value);
+         Assert::IsTrue(after->Lookup(2, value) == FALSE);
+
+         int sum = 0;
+         for (auto const & pair : before)
+            sum += pair.value;
+         Assert::AreEqual(30, sum);
+      }
+
+      TEST_METHOD(TestPublishedMap_Reclaim)
+      {
+         mfc::CPublishedMap<CMapStringToString> published;
+         published.Update([](CMapStringToString& m) { m.SetAt(_T("a"), _T("1")); });
+
+         {
+            auto view = published.Read();
+            published.Update([](CMapStringToString& m) { m.SetAt(_T("b"), _T("2")); });
+            published.Update([](CMapStringToString& m) { m.SetAt(_T("c"), _T("3")); });
+
+            // the version pinned by the view and the one after it are kept
+            Assert::IsTrue(published.GetRetiredCount() > 0);
+            Assert::AreEqual(static_cast<INT_PTR>(1), view->GetCount());
+         }
+
+         published.Update([](CMapStringToString& m) { m.RemoveKey(_T("a")); });
+         Assert::AreEqual(static_cast<INT_PTR>(0), published.GetRetiredCount());
+         Assert::AreEqual(static_cast<INT_PTR>(2), published.Read()->GetCount());
+      }
+
+      TEST_METHOD(TestPublishedMap_Threads)
+      {
+         mfc::CPublishedMap<CMap<int, int, int, int>> published;
+         published.Update([](CMap<int, int, int, int>& m) { for (int i = 0; i < 50; ++i) m.SetAt(i, 0); });
+
+         std::atomic<bool> consistent(true);
+         std::vector<std::thread> readers;
+         for (int r = 0; r < 3; ++r)
+         {
+            readers.emplace_back([&]() {
+               for (int i = 0; i < 200; ++i)
+               {
+                  auto view = published.Read();
+                  int first = -1;
+                  for (auto const & pair : view)
+                  {
+                     if (first == -1) first = pair.value;
+                     else if (pair.value != first) consistent = false;
+                  }
+               }
+            });
+         }
+
+         for (int i = 1; i <= 200; ++i)
+            published.Update([i](CMap<int, int, int, int>& m) { for (int k = 0; k < 50; ++k) m.SetAt(k, i); });
+
+         for (auto& reader : readers)
+            reader.join();
+         Assert::IsTrue(consistent.load());
+      }
+
+      TEST_METHOD(TestLockedCollection_ReadAndWrite)
+      {
+         mfc::CLockedCollection<CArray<int>> shared;
+         shared.Write([](CArray<int>& arr) { for (int i = 1; i <= 10; ++i) arr.Add(i); });
+
+         {
+            auto range = shared.Read();
+            Assert::AreEqual(static_cast<INT_PTR>(10), range.GetCount());
+            Assert::AreEqual(55, std::accumulate(range.begin(), range.end(), 0));
+
+            // readers share the lock: another thread reads while this one still holds its range
+            int last = 0;
+            std::thread reader([&shared, &last] { last = shared.Read()->GetAt(9); });
+            reader.join();
+            Assert::AreEqual(10, last);
+         }
+
+         INT_PTR const count = shared.Read([](CArray<int> const & arr) { return arr.GetCount(); });
+         Assert::AreEqual(static_cast<INT_PTR>(10), count);
+
+         auto const statistics = shared.GetStatistics();
+         Assert::AreEqual(3ull, static_cast<unsigned long long>(statistics.sharedAcquisitions));
+         Assert::AreEqual(1ull, static_cast<unsigned long long>(statistics.exclusiveAcquisitions));
+      }
+
+      TEST_METHOD(TestLockedCollection_QueuedWrites)
+      {
+         mfc::CLockedCollection<CList<int>> shared(4);
+         shared.Queue([](CList<int>& list) { list.AddTail(1); });
+         shared.Queue([](CList<int>& list) { list.AddTail(2); });
+         shared.Queue([](CList<int>& list) { list.AddTail(3); });
+
+         // below the batch size nothing is applied
+         Assert::AreEqual(static_cast<INT_PTR>(3), shared.GetQueuedCount());
+         Assert::IsTrue(shared.Read().IsEmpty() != FALSE);
+
+         shared.Queue([](CList<int>& list) { list.AddTail(4); });
+         Assert::AreEqual(static_cast<INT_PTR>(0), shared.GetQueuedCount());
+
+         // queued writes are applied before an immediate write
+         shared.Queue([](CList<int>& list) { list.AddTail(5); });
+         shared.Write([](CList<int>& list) { list.AddTail(6); });
+
+         std::vector<int> values;
+         for (int value : shared.Read())
+            values.push_back(value);
+         Assert::IsTrue(values == std::vector<int>({ 1, 2, 3, 4, 5, 6 }));
+
+         auto const statistics = shared.GetStatistics();
+         Assert::AreEqual(2ull, static_cast<unsigned long long>(statistics.batches));
+         Assert::AreEqual(5ull, static_cast<unsigned long long>(statistics.queuedWrites));
+      }
+
+      TEST_METHOD(TestLockedCollection_Threads)
+      {
+         mfc::CLockedCollection<CMap<int, int, int, int>> shared(16);
+
+         std::atomic<bool> consistent(true);
+         std::thread reader([&]() {
+            for (int i = 0; i < 200; ++i)
+            {
+               auto range = shared.Read();
+               for (auto const & pair : range)
+                  if (pair.value != pair.key * 2) consistent = false;
+            }
+         });
+
+         for (int i = 0; i < 1000; ++i)
+            shared.Queue([i](CMap<int, int, int, int>& map) { map.SetAt(i, i * 2); });
+         shared.Flush();
+
+         reader.join();
+         Assert::IsTrue(consistent.load());
+         Assert::AreEqual(static_cast<INT_PTR>(1000), shared.Read().GetCount());
+      }
+
+      TEST_METHOD(TestSpscRing_PushPop)
+      {
+         mfc::CSpscRing<CString> ring(3);
+         Assert::AreEqual(static_cast<size_t>(4), ring.GetCapacity());
+
+         Assert::IsTrue(ring.TryPush(_T("a")) != FALSE);
+         Assert::IsTrue(ring.TryPush(_T("b")) != FALSE);
+         Assert::IsTrue(ring.TryPush(_T("c")) != FALSE);
+         Assert::IsTrue(ring.TryPush(_T("d")) != FALSE);
+         Assert::IsTrue(ring.TryPush(_T("e")) == FALSE);
+
+         CString value;
+         Assert::IsTrue(ring.TryPop(value) != FALSE);
+         Assert::IsTrue(value == _T("a"));
+         Assert::IsTrue(ring.TryPush(_T("e")) != FALSE);
+
+         {
+            auto batch = ring.Drain();
+            Assert::AreEqual(static_cast<INT_PTR>(4), batch.GetSize());
+            Assert::IsTrue(mfc::join(batch, _T(",")) == _T("b,c,d,e"));
+         }
+
+         Assert::AreEqual(static_cast<INT_PTR>(0), ring.GetCount());
+         Assert::IsTrue(ring.TryPop(value) == FALSE);
+      }
+
+      TEST_METHOD(TestSpscRing_DrainAlgorithms)
+      {
+         mfc::CSpscRing<int> ring(16);
+         for (int i = 10; i > 0; --i)
+            ring.Push(i);
+
+         auto batch = ring.Drain(8);
+         Assert::AreEqual(static_cast<INT_PTR>(8), batch.GetSize());
+
+         // the batch is random-access, so it can be sorted in place in the ring
+         std::sort(batch.begin(), batch.end());
+         Assert::AreEqual(3, batch[0]);
+         Assert::AreEqual(10, batch[7]);
+         Assert::AreEqual(52, std::accumulate(begin(batch), end(batch), 0));
+
+         // the drained elements are not handed out a second time while the batch is alive
+         int value = 0;
+         Assert::IsTrue(ring.TryPop(value) == FALSE);
+         Assert::IsTrue(ring.Drain().IsEmpty() != FALSE);
+         batch.Release();
+
+         Assert::AreEqual(static_cast<INT_PTR>(2), ring.GetCount());
+      }
+
+      TEST_METHOD(TestSpscRing_Threads)
+      {
+         mfc::CSpscRing<int> ring(64);
+         int const count = 100000;
+
+         std::thread producer([&]() {
+            for (int i = 0; i < count; ++i)
+               ring.Push(i);
+         });
+
+         bool ordered = true;
+         int expected = 0;
+         while (expected < count)
+         {
+            auto batch = ring.Drain();
+            for (int value : batch)
+               if (value != expected++) ordered = false;
+         }
+
+         producer.join();
+         Assert::IsTrue(ordered);
+      }
+
+      TEST_METHOD(TestMpscRing_Threads)
+      {
+         mfc::CMpscRing<int> ring(128);
+         int const producers = 4;
+         int const count = 20000;
+
+         std::vector<std::thread> threads;
+         for (int p = 0; p < producers; ++p)
+         {
+            threads.emplace_back([&ring, p]() {
+               for (int i = 0; i < count; ++i)
+                  ring.Push(p * count + i);
+            });
+         }
+
+         // elements of one producer arrive in order
+         std::vector<int> last(producers, -1);
+         bool ordered = true;
+         int received = 0;
+         while (received < producers * count)
+         {
+            int value = 0;
+            if (ring.TryPop(value))
+            {
+               int const producer = value / count;
+               if (value <= last[producer]) ordered = false;
+               last[producer] = value;
+               ++received;
+            }
+
+            auto batch = ring.Drain(16);
+            for (int element : batch)
+            {
+               int const producer = element / count;
+               if (element <= last[producer]) ordered = false;
+               last[producer] = element;
+               ++received;
+            }
+         }
+
+         for (auto& thread : threads)
+            thread.join();
+         Assert::IsTrue(ordered);
+
+         int value = 0;
+         Assert::IsTrue(ring.TryPop(value) == FALSE);
+      }
+   };
+}
\ No newline at end of file
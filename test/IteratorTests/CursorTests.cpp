@@ -0,0 +1,139 @@
+#include "pch.h"
+#include "CppUnitTest.h"
+#include "..\..\include\mfciterators.h"
+#include "IntObject.h"
+
+#include "Specializations.h"  // last include
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+namespace IteratorTests
+{
+   TEST_CLASS(CursorTests)
+   {
+   private:
+      template <class TCollection, class F>
+      int RunInSlices(TCollection& collection, INT_PTR const slice, F fn)
+      {
+         auto cursor = mfc::make_cursor(collection);
+         int slices = 0;
+         mfc::cursor_status status;
+         do
+         {
+            status = cursor.run_for(slice, fn);
+            slices++;
+         } while (status == mfc::cursor_status::suspended);
+
+         Assert::IsTrue(status == mfc::cursor_status::completed);
+         Assert::IsTrue(cursor.IsComplete());
+         return slices;
+      }
+
+      TEST_METHOD(TestArray_Slices)
+      {
+         CArray<int> arr;
+         for (int i = 0; i < 100; ++i) arr.Add(i);
+
+         std::vector<int> visited;
+         int const slices = RunInSlices(arr, 30, [&visited](int const n) { visited.push_back(n); });
+
+         Assert::AreEqual(4, slices);
+         Assert::AreEqual(static_cast<size_t>(100), visited.size());
+         for (int i = 0; i < 100; ++i)
+            Assert::AreEqual(i, visited[i]);
+      }
+
+      TEST_METHOD(TestArray_Empty)
+      {
+         CDWordArray arr;
+         auto cursor = mfc::make_cursor(arr);
+         Assert::IsTrue(cursor.run_for(10, [](DWORD) { Assert::Fail(); }) == mfc::cursor_status::completed);
+      }
+
+      TEST_METHOD(TestList_Slices)
+      {
+         CStringList list;
+         for (int i = 0; i < 10; ++i)
+         {
+            CString str; str.Format(L"%d", i);
+            list.AddTail(str);
+         }
+
+         CString all;
+         int const slices = RunInSlices(list, 3, [&all](CString const & str) { all += str; });
+
+         Assert::AreEqual(4, slices);
+         Assert::AreEqual(CString(L"0123456789"), all);
+      }
+
+      TEST_METHOD(TestMap_Slices)
+      {
+         CMap<int, int, int, int> map;
+         for (int i = 0; i < 50; ++i) map[i] = i;
+
+         int sum = 0;
+         RunInSlices(map, 7, [&sum](CMap<int, int, int, int>::CPair& kvp) { sum += kvp.value; });
+         Assert::AreEqual(49 * 50 / 2, sum);
+
+         CMapStringToString smap;
+         smap[L"a"] = L"1";
+         smap[L"b"] = L"2";
+         smap[L"c"] = L"3";
+
+         int count = 0;
+         RunInSlices(smap, 1, [&count](CMapPair<CString, CString> const & kvp) { Assert::AreEqual(kvp.value.GetLength(), 1); count++; });
+         Assert::AreEqual(3, count);
+      }
+
+      TEST_METHOD(TestTimeBudget)
+      {
+         CArray<int> arr;
+         for (int i = 0; i < 1000; ++i) arr.Add(i);
+
+         auto cursor = mfc::make_cursor(arr);
+         int count = 0;
+         Assert::IsTrue(cursor.run_for(std::chrono::milliseconds(0), [&count](int) { count++; }) == mfc::cursor_status::suspended);
+         Assert::IsTrue(count > 0 && count < 1000);
+
+         Assert::IsTrue(cursor.run_for(std::chrono::hours(1), [&count](int) { count++; }) == mfc::cursor_status::completed);
+         Assert::AreEqual(1000, count);
+      }
+
+      TEST_METHOD(TestModified_Restart)
+      {
+         CList<int> list;
+         for (int i = 0; i < 10; ++i) list.AddTail(i);
+
+         auto cursor = mfc::make_cursor(list, mfc::on_modified::restart);
+         int count = 0;
+         Assert::IsTrue(cursor.run_for(5, [&count](int) { count++; }) == mfc::cursor_status::suspended);
+
+         list.AddTail(10);
+         count = 0;
+         Assert::IsTrue(cursor.run_for(100, [&count](int) { count++; }) == mfc::cursor_status::completed);
+         Assert::AreEqual(11, count);
+         Assert::AreEqual(static_cast<INT_PTR>(11), cursor.GetProcessed());
+      }
+
+      TEST_METHOD(TestModified_Stop)
+      {
+         CTypedPtrArray<CObArray, IntObject*> arr;
+         for (int i = 0; i < 10; ++i) arr.Add(new IntObject(i));
+
+         ULONGLONG version = 0;
+         auto cursor = mfc::make_cursor(arr, mfc::on_modified::stop, version);
+         Assert::IsTrue(cursor.run_for(5, [](IntObject*) {}) == mfc::cursor_status::suspended);
+
+         version++;
+         Assert::IsTrue(cursor.run_for(5, [](IntObject*) {}) == mfc::cursor_status::modified);
+         Assert::IsTrue(cursor.run_for(5, [](IntObject*) {}) == mfc::cursor_status::modified);
+         Assert::IsFalse(cursor.IsComplete());
+
+         cursor.Reset();
+         Assert::IsTrue(cursor.run_for(100, [](IntObject*) {}) == mfc::cursor_status::completed);
+
+         for (auto p : arr)
+            delete p;
+      }
+   };
+}
@@ -262,5 +262,89 @@ namespace IteratorTests
       {
          TestTypedPtrList<IntObject>(10);
       }
+
+      TEST_METHOD(TestFlatView_Scan)
+      {
+         CList<int> list;
+         for (int i = 0; i < 100; ++i) list.AddTail(i);
+
+         auto view = mfc::flat_view(list);
+         Assert::AreEqual(static_cast<INT_PTR>(100), view.GetCount());
+         Assert::AreEqual(4950, std::accumulate(view.begin(), view.end(), 0));
+         Assert::AreEqual(42, view[42]);
+         Assert::AreEqual(99, *(view.end() - 1));
+         Assert::IsTrue(std::binary_search(view.begin(), view.end(), 73));
+
+         // unchanged lists are not copied again
+         Assert::IsFalse(view.Refresh());
+
+         list.RemoveHead();
+         Assert::AreEqual(static_cast<INT_PTR>(99), view.GetCount());
+         Assert::AreEqual(1, view[0]);
+      }
+
+      TEST_METHOD(TestFlatView_Version)
+      {
+         CStringList list;
+         list.AddTail(_T("a"));
+         list.AddTail(_T("b"));
+
+         ULONGLONG version = 0;
+         auto view = mfc::flat_view(list, version);
+         Assert::IsTrue(view[1] == _T("b"));
+
+         // same count, so only the version token reveals the change
+         list.GetAt(list.GetTailPosition()) = _T("c");
+         Assert::IsTrue(view[1] == _T("b"));
+
+         ++version;
+         Assert::IsTrue(view[1] == _T("c"));
+         Assert::IsTrue(mfc::join(view, _T(",")) == _T("a,c"));
+      }
+
+      TEST_METHOD(TestFlatView_TypedPtrList)
+      {
+         CTypedPtrList<CObList, IntObject*> list;
+         for (int i = 0; i < 10; ++i) list.AddTail(new IntObject(i));
+
+         auto view = mfc::flat_view(list);
+         Assert::IsTrue(view.GetData()[0] == list.GetHead());
+         Assert::AreEqual(45, std::accumulate(view.begin(), view.end(), 0, [](int sum, IntObject* o) { return sum + o->value; }));
+
+         for (auto p : list)
+            delete p;
+      }
+
+      TEST_METHOD(TestFlatView_EndBeforeBegin)
+      {
+         CList<int> list;
+         for (int i = 0; i < 10; ++i) list.AddTail(i);
+
+         auto view = mfc::flat_view(list);
+         Assert::AreEqual(static_cast<INT_PTR>(10), view.GetCount());
+
+         // the end iterator follows the rebuild done by the begin() call after it
+         auto const last = view.end();
+         list.AddTail(10);
+         auto const first = view.begin();
+         Assert::AreEqual(static_cast<ptrdiff_t>(11), last - first);
+         Assert::AreEqual(55, std::accumulate(first, last, 0));
+      }
+
+      TEST_METHOD(TestFlatPointerView_Scan)
+      {
+         CStringList list;
+         list.AddTail(_T("a"));
+         list.AddTail(_T("b"));
+
+         auto view = mfc::flat_pointer_view(list);
+         Assert::IsTrue(view.GetData()[1] == &list.GetAt(list.GetTailPosition()));
+
+         // the view points into the list, so changes in place are visible without a rebuild
+         list.GetAt(list.GetTailPosition()) = _T("c");
+         Assert::IsTrue(view[1] == _T("c"));
+         Assert::IsTrue(mfc::join(view, _T(",")) == _T("a,c"));
+         Assert::IsFalse(view.Refresh());
+      }
    };
 }
\ No newline at end of file
@@ -421,5 +421,88 @@ namespace IteratorTests
       {
          TestNumericToObjectTypedMap<IntObject, CTypedPtrMap<CMapWordToPtr, WORD, IntObject*>>(10);
       }
+
+      TEST_METHOD(TestSortedView_TemplateMap)
+      {
+         CMap<int, int, int, int> map;
+         for (int i = 0; i < 100; ++i) map[(i * 37) % 100] = i;
+
+         auto view = mfc::sorted_view(map);
+         Assert::AreEqual(static_cast<INT_PTR>(100), view.GetCount());
+
+         int expected = 0;
+         for (auto const & kvp : view)
+         {
+            Assert::AreEqual(expected, kvp.key);
+            expected++;
+         }
+
+         Assert::IsTrue(std::is_sorted(view.begin(), view.end(),
+            [](auto const & left, auto const & right) { return left.key < right.key; }));
+         Assert::IsFalse(view.Refresh());
+
+         map[100] = 100;
+         Assert::IsTrue(view.Refresh());
+         Assert::AreEqual(100, (*(view.end() - 1)).key);
+      }
+
+      TEST_METHOD(TestSortedView_Comparer)
+      {
+         CMapStringToString map;
+         for (int i = 0; i < 10; ++i)
+         {
+            CString key; key.Format(L"key_%d", i);
+            CString value; value.Format(L"%d", 9 - i);
+            map[key] = value;
+         }
+
+         CMapStringToString const & cmap = map;
+         auto view = mfc::sorted_view(cmap,
+            [](CMapPair<CString, CString> const & left, CMapPair<CString, CString> const & right) { return left.value < right.value; });
+
+         int expected = 0;
+         for (auto const & kvp : view)
+         {
+            CString value; value.Format(L"%d", expected);
+            Assert::AreEqual(value, kvp.value);
+            expected++;
+         }
+
+         Assert::AreEqual(10, expected);
+      }
+
+      TEST_METHOD(TestSortedView_VersionToken)
+      {
+         CMapWordToPtr map;
+         for (WORD i = 1; i <= 10; ++i) map[i] = nullptr;
+
+         ULONGLONG version = 0;
+         auto view = mfc::sorted_view(map, mfc::key_less(), version);
+         Assert::AreEqual(static_cast<WORD>(1), (*view.begin()).key);
+
+         map.RemoveKey(1);
+         map[20] = nullptr;
+         version++;
+
+         Assert::IsTrue(view.Refresh());
+         Assert::AreEqual(static_cast<WORD>(2), (*view.begin()).key);
+         Assert::AreEqual(static_cast<WORD>(20), view.begin()[9].key);
+      }
+
+      TEST_METHOD(TestSortedView_EndBeforeBegin)
+      {
+         CMap<int, int, int, int> map;
+         for (int i = 0; i < 10; ++i) map[i] = i;
+
+         auto view = mfc::sorted_view(map);
+         Assert::AreEqual(static_cast<INT_PTR>(10), view.GetCount());
+
+         // an end iterator taken before begin() rebuilt the index still matches it
+         for (int i = 10; i < 100; ++i) map[i] = i;
+         auto const last = view.end();
+         auto const first = view.begin();
+         Assert::AreEqual(static_cast<ptrdiff_t>(100), last - first);
+         Assert::AreEqual(4950, std::accumulate(first, last, 0, [](int sum, CMap<int, int, int, int>::CPair const & kvp) { return sum + kvp.value; }));
+      }
    };
 }
\ No newline at end of file
@@ -0,0 +1,373 @@
+#include "pch.h"
+#include "CppUnitTest.h"
+#include "..\..\include\mfciterators.h"
+#include "IntObject.h"
+
+#include <atomic>
+#include <functional>
+
+#include "Specializations.h"  // last include
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+namespace IteratorTests
+{
+   TEST_CLASS(ParallelTests)
+   {
+   private:
+      template <class TMap>
+      void TestParallelNumericMap(int const n, UINT const hashSize)
+      {
+         TMap map;
+         map.InitHashTable(hashSize);
+         for (int i = 0; i < n; ++i) map[i] = i;
+
+         std::vector<std::atomic<int>> visits(n);
+         for (auto & v : visits) v = 0;
+
+         mfc::parallel::for_each(map, [&visits](auto const & kvp) {
+            Assert::IsTrue(kvp.key == kvp.value);
+            visits[static_cast<size_t>(kvp.key)]++;
+         });
+
+         for (auto const & v : visits)
+            Assert::AreEqual(1, v.load());
+      }
+
+      TEST_METHOD(TestForEach_TemplateMap_Empty)
+      {
+         TestParallelNumericMap<CMap<__int64, __int64, __int64, __int64>>(0, 17);
+      }
+
+      TEST_METHOD(TestForEach_TemplateMap_One)
+      {
+         TestParallelNumericMap<CMap<__int64, __int64, __int64, __int64>>(1, 17);
+      }
+
+      TEST_METHOD(TestForEach_TemplateMap_Many)
+      {
+         TestParallelNumericMap<CMap<__int64, __int64, __int64, __int64>>(100000, 4099);
+      }
+
+      TEST_METHOD(TestForEach_TemplateMap_FewBuckets)
+      {
+         TestParallelNumericMap<CMap<int, int, int, int>>(1000, 3);
+      }
+
+      TEST_METHOD(TestForEach_TemplateMap_Modify)
+      {
+         CMap<int, int, int, int> map;
+         map.InitHashTable(1021);
+         for (int i = 0; i < 10000; ++i) map[i] = i;
+
+         mfc::parallel::for_each(map, [](CMap<int, int, int, int>::CPair& kvp) { kvp.value *= 2; });
+
+         for (auto const & kvp : map)
+            Assert::AreEqual(kvp.key * 2, kvp.value);
+      }
+
+      TEST_METHOD(TestForEach_WordToPtrMap)
+      {
+         CMapWordToPtr map;
+         map.InitHashTable(257);
+         for (WORD i = 0; i < 5000; ++i) map[i] = reinterpret_cast<void*>(static_cast<INT_PTR>(i));
+
+         std::vector<std::atomic<int>> visits(5000);
+         for (auto & v : visits) v = 0;
+
+         CMapWordToPtr const & cmap = map;
+         mfc::parallel::for_each(cmap, [&visits](CMapPair<WORD, void*> const & kvp) {
+            Assert::IsTrue(reinterpret_cast<INT_PTR>(kvp.value) == kvp.key);
+            visits[kvp.key]++;
+         });
+
+         for (auto const & v : visits)
+            Assert::AreEqual(1, v.load());
+      }
+
+      TEST_METHOD(TestForEach_TypedPtrMap)
+      {
+         CTypedPtrMap<CMapStringToPtr, CString, IntObject*> map;
+         std::vector<IntObject*> objects;
+         for (int i = 0; i < 1000; ++i)
+         {
+            objects.push_back(new IntObject(i));
+            CString key; key.Format(L"element_%d", i);
+            map[key] = objects.back();
+         }
+
+         std::atomic<int> sum(0);
+         mfc::parallel::for_each(map, [&sum](CMapPair<CString, IntObject*> const & kvp) { sum += kvp.value->value; });
+         Assert::AreEqual(999 * 1000 / 2, sum.load());
+
+         for (auto p : objects)
+            delete p;
+      }
+
+      TEST_METHOD(TestForEach_Exception)
+      {
+         CMap<int, int, int, int> map;
+         for (int i = 0; i < 1000; ++i) map[i] = i;
+
+         Assert::ExpectException<std::runtime_error>([&map]() {
+            mfc::parallel::for_each(map, [](CMap<int, int, int, int>::CPair const & kvp) {
+               if (kvp.key == 500)
+                  throw std::runtime_error("failed");
+            });
+         });
+      }
+
+      TEST_METHOD(TestGroupReduce_Array)
+      {
+         CArray<int> arr;
+         for (int i = 0; i < 100000; ++i) arr.Add(i);
+
+         CMap<int, int, __int64, __int64> sums;
+         mfc::group_reduce(arr,
+            [](int const n) { return n % 10; },
+            [](int const n) { return static_cast<__int64>(n); },
+            std::plus<__int64>(),
+            sums);
+
+         Assert::AreEqual(static_cast<INT_PTR>(10), static_cast<INT_PTR>(sums.GetCount()));
+         for (auto const & kvp : sums)
+         {
+            __int64 expected = 0;
+            for (int i = kvp.key; i < 100000; i += 10) expected += i;
+            Assert::IsTrue(expected == kvp.value);
+         }
+      }
+
+      TEST_METHOD(TestGroupReduce_Empty)
+      {
+         CArray<int> arr;
+         CMap<int, int, int, int> counts;
+         mfc::group_reduce(arr, [](int const n) { return n; }, [](int const) { return 1; }, std::plus<int>(), counts);
+
+         Assert::IsTrue(counts.IsEmpty());
+      }
+
+      TEST_METHOD(TestGroupReduce_StringList)
+      {
+         CStringList list;
+         for (int i = 0; i < 1000; ++i)
+         {
+            CString str; str.Format(L"word_%d", i % 7);
+            list.AddTail(str);
+         }
+
+         CMap<CString, LPCTSTR, int, int> counts;
+         mfc::group_reduce(list,
+            [](CString const & str) { return str; },
+            [](CString const &) { return 1; },
+            std::plus<int>(),
+            counts);
+
+         Assert::AreEqual(static_cast<INT_PTR>(7), static_cast<INT_PTR>(counts.GetCount()));
+
+         int total = 0;
+         for (auto const & kvp : counts)
+         {
+            int const index = _wtoi(static_cast<LPCTSTR>(kvp.key) + 5);
+            Assert::AreEqual(1000 / 7 + (index < 1000 % 7 ? 1 : 0), kvp.value);
+            total += kvp.value;
+         }
+
+         Assert::AreEqual(1000, total);
+      }
+
+      TEST_METHOD(TestGroupReduce_MergeIntoExisting)
+      {
+         CTypedPtrArray<CPtrArray, IntObject*> arr;
+         for (int i = 0; i < 100; ++i) arr.Add(new IntObject(i));
+
+         CMap<int, int, int, int> maxima;
+         maxima[0] = 1000;
+         mfc::group_reduce(arr,
+            [](IntObject* o) { return o->value % 2; },
+            [](IntObject* o) { return o->value; },
+            [](int const a, int const b) { return (std::max)(a, b); },
+            maxima);
+
+         Assert::AreEqual(1000, maxima[0]);
+         Assert::AreEqual(99, maxima[1]);
+
+         for (auto p : arr)
+            delete p;
+      }
+
+      TEST_METHOD(TestExecutor_SerialIsOrdered)
+      {
+         mfc::CSerialExecutor serial;
+         Assert::AreEqual(static_cast<INT_PTR>(1), serial.GetConcurrency());
+
+         std::vector<INT_PTR> order;
+         serial.Bulk(5, [&order](INT_PTR const i) { order.push_back(i); });
+         Assert::IsTrue(order == std::vector<INT_PTR>({ 0, 1, 2, 3, 4 }));
+
+         CMap<int, int, int, int> map;
+         for (int i = 0; i < 100; ++i) map[i] = i;
+
+         std::thread::id const caller = std::this_thread::get_id();
+         bool same_thread = true;
+         int sum = 0;
+         mfc::parallel::for_each(serial, map, [&](CMap<int, int, int, int>::CPair const & kvp) {
+            same_thread = same_thread && std::this_thread::get_id() == caller;
+            sum += kvp.value;
+         });
+         Assert::IsTrue(same_thread);
+         Assert::AreEqual(4950, sum);
+      }
+
+      TEST_METHOD(TestExecutor_ThreadPoolBulk)
+      {
+         mfc::CThreadPool pool(3);
+         Assert::AreEqual(static_cast<INT_PTR>(3), pool.GetConcurrency());
+
+         std::vector<std::atomic<int>> visits(1000);
+         for (auto & v : visits) v = 0;
+         pool.Bulk(1000, [&visits](INT_PTR const i) { visits[static_cast<size_t>(i)]++; });
+         for (auto const & v : visits)
+            Assert::AreEqual(1, v.load());
+
+         // nested bulk calls from the pool's own tasks complete
+         std::atomic<int> inner(0);
+         pool.Bulk(4, [&](INT_PTR) {
+            pool.Bulk(10, [&inner](INT_PTR) { inner++; });
+         });
+         Assert::AreEqual(40, inner.load());
+
+         Assert::ExpectException<std::out_of_range>([&pool]() {
+            pool.Bulk(100, [](INT_PTR const i) { if (i == 50) throw std::out_of_range("test"); });
+         });
+      }
+
+      TEST_METHOD(TestExecutor_Submit)
+      {
+         std::atomic<int> done(0);
+         {
+            mfc::CThreadPool pool(2);
+            for (int i = 0; i < 100; ++i)
+               pool.Submit([&done]() { done++; });
+         }
+         // the destructor runs the queued tasks
+         Assert::AreEqual(100, done.load());
+      }
+
+      TEST_METHOD(TestExecutor_Default)
+      {
+         mfc::CSerialExecutor serial;
+         mfc::CExecutor* const previous = mfc::set_default_executor(&serial);
+         Assert::IsTrue(&mfc::default_executor() == &serial);
+
+         CArray<int> values;
+         for (int i = 0; i < 100; ++i) values.Add(i);
+
+         CMap<int, int, int, int> sums;
+         mfc::group_reduce(values,
+            [](int const v) { return v % 3; },
+            [](int const v) { return v; },
+            std::plus<int>(),
+            sums);
+         Assert::AreEqual(1683, sums[0]);
+
+         mfc::set_default_executor(previous);
+         Assert::IsTrue(&mfc::default_executor() != &serial);
+
+         CMap<int, int, int, int> pooled;
+         mfc::CThreadPool pool(2);
+         mfc::group_reduce(pool, values,
+            [](int const v) { return v % 3; },
+            [](int const v) { return v; },
+            std::plus<int>(),
+            pooled);
+         Assert::AreEqual(sums[1], pooled[1]);
+         Assert::AreEqual(sums[2], pooled[2]);
+      }
+
+      TEST_METHOD(TestForEach_List)
+      {
+         CList<int> list;
+         for (int i = 0; i < 10000; ++i) list.AddTail(i);
+
+         std::vector<std::atomic<int>> visits(10000);
+         for (auto & v : visits) v = 0;
+
+         mfc::parallel::for_each(list, [&visits](int& value) {
+            visits[static_cast<size_t>(value)]++;
+            value *= 2;
+         });
+
+         for (auto const & v : visits)
+            Assert::AreEqual(1, v.load());
+         Assert::AreEqual(19998, list.GetTail());
+      }
+
+      TEST_METHOD(TestForEach_List_Empty)
+      {
+         CStringList list;
+         int calls = 0;
+         mfc::parallel::for_each(list, [&calls](CString const &) { ++calls; });
+         Assert::AreEqual(0, calls);
+      }
+
+      TEST_METHOD(TestForEach_List_CachedTable)
+      {
+         CTypedPtrList<CObList, IntObject*> list;
+         for (int i = 0; i < 1000; ++i) list.AddTail(new IntObject(i));
+
+         ULONGLONG version = 0;
+         mfc::CListSkipTable<CTypedPtrList<CObList, IntObject*>> table(&version);
+         table.Build(list, 100);
+         Assert::AreEqual(static_cast<INT_PTR>(10), table.GetSegmentCount());
+         Assert::IsTrue(table.GetSegmentStart(0) == list.GetHeadPosition());
+         Assert::IsTrue(table.GetSegmentStart(10) == nullptr);
+
+         mfc::CSerialExecutor serial;
+         std::atomic<int> sum(0);
+         mfc::parallel::for_each(serial, list, table, [&sum](IntObject* o) { sum += o->value; });
+         Assert::AreEqual(499500, sum.load());
+         Assert::AreEqual(static_cast<INT_PTR>(100), table.GetStride());
+
+         // the table is rebuilt once the list changed
+         list.AddTail(new IntObject(1000));
+         Assert::IsTrue(table.IsCurrent(list) == FALSE);
+
+         sum = 0;
+         mfc::parallel::for_each(list, table, [&sum](IntObject* o) { sum += o->value; });
+         Assert::AreEqual(500500, sum.load());
+         Assert::IsTrue(table.IsCurrent(list) != FALSE);
+
+         // replacing an inner node keeps the count and both ends, so it is signalled through the token
+         POSITION const inner = list.FindIndex(500);
+         delete list.GetAt(inner);
+         list.InsertBefore(inner, new IntObject(500));
+         list.RemoveAt(inner);
+         ++version;
+         Assert::IsTrue(table.IsCurrent(list) == FALSE);
+
+         sum = 0;
+         mfc::parallel::for_each(list, table, [&sum](IntObject* o) { sum += o->value; });
+         Assert::AreEqual(500500, sum.load());
+
+         for (auto p : list)
+            delete p;
+      }
+
+      TEST_METHOD(TestForEach_PtrList)
+      {
+         int values[500];
+         CPtrList list;
+         for (int i = 0; i < 500; ++i)
+         {
+            values[i] = i;
+            list.AddTail(&values[i]);
+         }
+
+         mfc::CThreadPool pool(4);
+         std::atomic<int> sum(0);
+         mfc::parallel::for_each(pool, list, [&sum](void* p) { sum += *static_cast<int*>(p); });
+         Assert::AreEqual(124750, sum.load());
+      }
+   };
+}
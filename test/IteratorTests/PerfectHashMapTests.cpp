@@ -0,0 +1,163 @@
+#include "pch.h"
+#include "CppUnitTest.h"
+#include "..\..\include\mfciterators.h"
+#include "IntObject.h"
+
+#include "Specializations.h"  // last include
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+namespace IteratorTests
+{
+   TEST_CLASS(PerfectHashMapTests)
+   {
+   private:
+      static void FillStringMap(CMapStringToPtr& map, int const n)
+      {
+         for (int i = 0; i < n; ++i)
+         {
+            CString str; str.Format(L"key_%d", i);
+            map[str] = reinterpret_cast<void*>(static_cast<INT_PTR>(i + 1));
+         }
+      }
+
+      TEST_METHOD(TestEmpty)
+      {
+         CMapStringToPtr map;
+         mfc::CPerfectHashMap<CString, void*> phm(map);
+
+         Assert::IsTrue(phm.IsEmpty());
+         Assert::IsTrue(phm.PLookup(L"key_0") == nullptr);
+         Assert::IsTrue(phm.begin() == phm.end());
+      }
+
+      TEST_METHOD(TestStringToPtr_Lookup)
+      {
+         CMapStringToPtr map;
+         FillStringMap(map, 5000);
+
+         auto phm = mfc::make_perfect_hash_map(map);
+         Assert::AreEqual(map.GetCount(), phm.GetCount());
+
+         for (auto const & kvp : map)
+         {
+            void* value = nullptr;
+            Assert::IsTrue(phm.Lookup(kvp.key, value) != FALSE);
+            Assert::IsTrue(kvp.value == value);
+         }
+
+         Assert::IsTrue(phm.PLookup(L"missing") == nullptr);
+         Assert::IsTrue(phm.PLookup(L"key_5000") == nullptr);
+      }
+
+      TEST_METHOD(TestStringToPtr_MutableBufferKey)
+      {
+         CMapStringToPtr map;
+         FillStringMap(map, 100);
+         auto phm = mfc::make_perfect_hash_map(map);
+
+         // a non-const character buffer is hashed as a string, not by address
+         TCHAR key[16] = _T("key_42");
+         TCHAR* const buffer = key;
+         void* value = nullptr;
+         Assert::IsTrue(phm.Lookup(buffer, value) != FALSE);
+         Assert::IsTrue(value == reinterpret_cast<void*>(static_cast<INT_PTR>(43)));
+      }
+
+      TEST_METHOD(TestPointerKeys_CompareText)
+      {
+         typedef mfc::CPerfectHashMap<LPCTSTR, int> map_type;
+         std::vector<map_type::pair_type> entries;
+         LPCTSTR const names[] = { _T("alpha"), _T("beta"), _T("gamma"), _T("delta"), _T("epsilon") };
+         for (int i = 0; i < 5; ++i)
+            entries.push_back(map_type::pair_type{ names[i], i });
+
+         map_type phm;
+         phm.Build(entries);
+
+         // the same text in another buffer finds the key, since LPCTSTR keys hash and compare by content
+         TCHAR key[16] = _T("gamma");
+         LPCTSTR const lookup = key;
+         int value = -1;
+         Assert::IsTrue(phm.Lookup(lookup, value) != FALSE);
+         Assert::AreEqual(2, value);
+         Assert::IsTrue(phm.PLookup(_T("zeta")) == nullptr);
+      }
+
+      TEST_METHOD(TestStringToPtr_Iterate)
+      {
+         CMapStringToPtr map;
+         FillStringMap(map, 100);
+
+         mfc::CPerfectHashMap<CString, void*> phm(map);
+
+         int count = 0;
+         for (auto const & kvp : phm)
+         {
+            void* value = nullptr;
+            Assert::IsTrue(map.Lookup(kvp.key, value) != FALSE);
+            Assert::IsTrue(kvp.value == value);
+            count++;
+         }
+
+         Assert::AreEqual(100, count);
+      }
+
+      TEST_METHOD(TestTemplateMap)
+      {
+         CMap<int, int, CString, CString const &> map;
+         for (int i = -50; i < 50; ++i)
+         {
+            CString str; str.Format(L"%d", i);
+            map[i] = str;
+         }
+
+         auto phm = mfc::make_perfect_hash_map(map);
+         for (int i = -50; i < 50; ++i)
+         {
+            auto const * entry = phm.PLookup(i);
+            Assert::IsNotNull(entry);
+
+            CString str; str.Format(L"%d", i);
+            Assert::AreEqual(str, entry->value);
+         }
+
+         Assert::IsNull(phm.PLookup(50));
+      }
+
+      TEST_METHOD(TestSerialize)
+      {
+         CMapStringToString map;
+         for (int i = 0; i < 1000; ++i)
+         {
+            CString key; key.Format(L"k%d", i);
+            CString value; value.Format(L"v%d", i);
+            map[key] = value;
+         }
+
+         mfc::CPerfectHashMap<CString, CString> phm(map);
+
+         CMemFile file;
+         {
+            CArchive ar(&file, CArchive::store);
+            phm.Serialize(ar);
+         }
+
+         file.SeekToBegin();
+
+         mfc::CPerfectHashMap<CString, CString> loaded;
+         {
+            CArchive ar(&file, CArchive::load);
+            loaded.Serialize(ar);
+         }
+
+         Assert::AreEqual(phm.GetCount(), loaded.GetCount());
+         for (auto const & kvp : map)
+         {
+            CString value;
+            Assert::IsTrue(loaded.Lookup(kvp.key, value) != FALSE);
+            Assert::AreEqual(kvp.value, value);
+         }
+      }
+   };
+}
@@ -0,0 +1,272 @@
+#include "pch.h"
+#include "CppUnitTest.h"
+#include "..\..\include\mfciterators.h"
+#include "IntObject.h"
+
+#include "Specializations.h"  // last include
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+namespace IteratorTests
+{
+   class CShape : public CObject
+   {
+      DECLARE_DYNAMIC(CShape)
+   public:
+      int id = 0;
+   };
+
+   class CCircle : public CShape
+   {
+      DECLARE_DYNAMIC(CCircle)
+   };
+
+   class CSquare : public CShape
+   {
+      DECLARE_DYNAMIC(CSquare)
+   };
+
+   // no DECLARE_DYNAMIC: its objects report the runtime class of CCircle
+   class CLabelledCircle : public CCircle
+   {
+   public:
+      CString label;
+   };
+
+   struct Payload
+   {
+      static int instances;
+
+      CString  name;
+      int      value;
+
+      explicit Payload(int const v) : name(_T("payload")), value(v) { ++instances; }
+      Payload(Payload&& other) : name(std::move(other.name)), value(other.value) { ++instances; }
+      ~Payload() { --instances; }
+   };
+
+   int Payload::instances = 0;
+
+   IMPLEMENT_DYNAMIC(CShape, CObject)
+   IMPLEMENT_DYNAMIC(CCircle, CShape)
+   IMPLEMENT_DYNAMIC(CSquare, CShape)
+
+   TEST_CLASS(PointerTests)
+   {
+   private:
+      template <typename T>
+      static T* Make(int const id)
+      {
+         T* shape = new T();
+         shape->id = id;
+         return shape;
+      }
+
+      template <typename C>
+      static void DeleteShapes(C& collection)
+      {
+         for (auto object : collection)
+            delete object;
+      }
+
+      TEST_METHOD(TestOfKind_Array)
+      {
+         CObArray arr;
+         arr.Add(Make<CCircle>(1));
+         arr.Add(Make<CSquare>(2));
+         arr.Add(nullptr);
+         arr.Add(Make<CCircle>(3));
+         arr.Add(new IntObject(4));
+
+         std::vector<int> ids;
+         for (CCircle* circle : OF_KIND(CCircle, arr))
+            ids.push_back(circle->id);
+
+         Assert::AreEqual(static_cast<size_t>(2), ids.size());
+         Assert::AreEqual(1, ids[0]);
+         Assert::AreEqual(3, ids[1]);
+
+         auto shapes = OF_KIND(CShape, arr);
+         Assert::AreEqual(static_cast<ptrdiff_t>(3), std::distance(shapes.begin(), shapes.end()));
+
+         DeleteShapes(arr);
+      }
+
+      TEST_METHOD(TestOfKind_List)
+      {
+         CObList list;
+         list.AddTail(new IntObject(1));
+         list.AddTail(Make<CSquare>(2));
+         list.AddTail(Make<CSquare>(3));
+
+         int sum = 0;
+         for (CSquare* square : OF_KIND(CSquare, list))
+            sum += square->id;
+         Assert::AreEqual(5, sum);
+
+         CObList const & clist = list;
+         int count = 0;
+         for (CShape const * shape : mfc::of_kind<CShape>(clist))
+         {
+            Assert::IsTrue(shape->IsKindOf(RUNTIME_CLASS(CSquare)));
+            ++count;
+         }
+         Assert::AreEqual(2, count);
+
+         auto circles = OF_KIND(CCircle, list);
+         Assert::IsTrue(circles.begin() == circles.end());
+
+         DeleteShapes(list);
+      }
+
+      TEST_METHOD(TestOfKind_UndeclaredDerivedClass)
+      {
+         CObArray arr;
+         arr.Add(Make<CCircle>(1));
+         arr.Add(Make<CLabelledCircle>(2));
+         arr.Add(Make<CSquare>(3));
+
+         // objects of a class without DECLARE_DYNAMIC are matched as their declared base
+         int sum = 0;
+         for (CCircle* circle : OF_KIND(CCircle, arr))
+            sum += circle->id;
+         Assert::AreEqual(3, sum);
+
+         // CLabelledCircle::GetThisClass() is CCircle's runtime class, which of_kind<CLabelledCircle> rejects
+         // because its object size is not that of CLabelledCircle
+         Assert::IsTrue(CLabelledCircle::GetThisClass() == RUNTIME_CLASS(CCircle));
+         Assert::IsTrue(CLabelledCircle::GetThisClass()->m_nObjectSize != static_cast<int>(sizeof(CLabelledCircle)));
+
+         DeleteShapes(arr);
+      }
+
+      TEST_METHOD(TestCompact_Array)
+      {
+         Payload::instances = 0;
+         {
+            mfc::CCompactable<CTypedPtrArray<CPtrArray, Payload*>> arr;
+            for (int i = 0; i < 100; ++i)
+               arr.Add(new Payload(i));
+
+            arr.Compact();
+
+            Assert::AreEqual(100, Payload::instances);
+            for (int i = 0; i < 100; ++i)
+            {
+               Assert::AreEqual(i, arr[i]->value);
+               Assert::IsTrue(arr[i]->name == _T("payload"));
+               Assert::IsTrue(arr.IsCompacted(arr[i]) != FALSE);
+            }
+            Assert::IsTrue(arr[99] - arr[0] == 99);
+
+            arr.Add(new Payload(100));
+            Assert::IsFalse(arr.IsCompacted(arr[100]) != FALSE);
+
+            arr.DeleteElement(arr[0]);
+            arr.RemoveAt(0);
+            Assert::AreEqual(100, Payload::instances);
+
+            arr.Compact();
+            Assert::AreEqual(100, Payload::instances);
+            Assert::AreEqual(100, arr[99]->value);
+            Assert::IsTrue(arr.IsCompacted(arr[99]) != FALSE);
+         }
+         Assert::AreEqual(0, Payload::instances);
+      }
+
+      TEST_METHOD(TestCompact_List)
+      {
+         Payload::instances = 0;
+
+         mfc::CCompactable<CTypedPtrList<CPtrList, Payload*>> list;
+         for (int i = 0; i < 10; ++i)
+            list.AddTail(new Payload(i));
+
+         list.Compact();
+
+         int expected = 0;
+         for (Payload* payload : list)
+         {
+            Assert::AreEqual(expected++, payload->value);
+            Assert::IsTrue(list.IsCompacted(payload) != FALSE);
+         }
+
+         list.AddTail(new Payload(10));
+         list.DeleteAll();
+         Assert::AreEqual(0, Payload::instances);
+         Assert::IsTrue(list.IsEmpty() != FALSE);
+      }
+
+      TEST_METHOD(TestArena_New)
+      {
+         Payload::instances = 0;
+
+         mfc::CObjectArena arena(256);
+         Payload* const payload = arena.New<Payload>(7);
+         double* const number = arena.New<double>(1.5);
+         char* const ch = arena.New<char>('x');
+         ULONGLONG* const big = arena.New<ULONGLONG>(42ULL);
+
+         Assert::AreEqual(7, payload->value);
+         Assert::AreEqual(1.5, *number);
+         Assert::AreEqual('x', *ch);
+         Assert::IsTrue(*big == 42ULL);
+         Assert::IsTrue(reinterpret_cast<UINT_PTR>(big) % alignof(ULONGLONG) == 0);
+
+         for (int i = 0; i < 100; ++i)
+            arena.New<Payload>(i);
+         Assert::AreEqual(101, Payload::instances);
+         Assert::IsTrue(arena.GetAllocatedBytes() > 256);
+
+         arena.Release();
+         Assert::AreEqual(0, Payload::instances);
+         Assert::AreEqual(static_cast<size_t>(0), arena.GetAllocatedBytes());
+
+         arena.New<Payload>(1);
+         Assert::AreEqual(1, Payload::instances);
+      }
+
+      TEST_METHOD(TestArena_Containers)
+      {
+         Payload::instances = 0;
+         {
+            mfc::CArenaOwned<CTypedPtrList<CPtrList, Payload*>> list;
+            for (int i = 0; i < 1000; ++i)
+               list.AddTail(list.New(i));
+
+            int expected = 0;
+            for (Payload* payload : list)
+               Assert::AreEqual(expected++, payload->value);
+            Assert::AreEqual(1000, Payload::instances);
+
+            list.Release();
+            Assert::AreEqual(0, Payload::instances);
+            Assert::IsTrue(list.IsEmpty() != FALSE);
+
+            list.AddTail(list.New(1));
+         }
+         Assert::AreEqual(0, Payload::instances);
+      }
+
+      TEST_METHOD(TestDeleteAll)
+      {
+         Payload::instances = 0;
+
+         CTypedPtrArray<CPtrArray, Payload*> arr;
+         for (int i = 0; i < 10; ++i)
+            arr.Add(new Payload(i));
+
+         mfc::delete_all(arr);
+         Assert::AreEqual(0, Payload::instances);
+         Assert::IsTrue(arr.IsEmpty() != FALSE);
+
+         CTypedPtrMap<CMapWordToPtr, WORD, Payload*> map;
+         map.SetAt(1, new Payload(1));
+         map.SetAt(2, new Payload(2));
+
+         mfc::delete_all(map);
+         Assert::AreEqual(0, Payload::instances);
+         Assert::IsTrue(map.IsEmpty() != FALSE);
+      }
+   };
+}
\ No newline at end of file
@@ -0,0 +1,348 @@
+#include "pch.h"
+#include "CppUnitTest.h"
+#include "..\..\include\mfciterators.h"
+#include "IntObject.h"
+
+#include "Specializations.h"  // last include
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+namespace IteratorTests
+{
+   TEST_CLASS(SerializationTests)
+   {
+   private:
+      template <class TCollection>
+      void Store(TCollection& collection, CMemFile& file)
+      {
+         {
+            CArchive ar(&file, CArchive::store);
+            collection.Serialize(ar);
+         }
+         file.SeekToBegin();
+      }
+
+      template <class TArray, class TSource>
+      void RoundTrip(TSource const & source, TArray& target)
+      {
+         CMemFile file;
+         {
+            CArchive ar(&file, CArchive::store);
+            mfc::write_blob(ar, source);
+         }
+
+         file.SeekToBegin();
+         {
+            CArchive ar(&file, CArchive::load);
+            mfc::read_blob(ar, target);
+         }
+      }
+
+      TEST_METHOD(TestBlob_Points)
+      {
+         CArray<POINT> points;
+         for (LONG i = 0; i < 1000; ++i)
+         {
+            POINT pt = { i, -i };
+            points.Add(pt);
+         }
+
+         CArray<POINT> loaded;
+         RoundTrip(points, loaded);
+
+         Assert::AreEqual(points.GetSize(), loaded.GetSize());
+         for (INT_PTR i = 0; i < points.GetSize(); ++i)
+         {
+            Assert::AreEqual(points[i].x, loaded[i].x);
+            Assert::AreEqual(points[i].y, loaded[i].y);
+         }
+      }
+
+      TEST_METHOD(TestBlob_DWordArray)
+      {
+         CDWordArray arr;
+         for (DWORD i = 0; i < 100; ++i) arr.Add(i * 3);
+
+         CDWordArray loaded;
+         loaded.Add(42);
+         RoundTrip(arr, loaded);
+
+         Assert::AreEqual(static_cast<INT_PTR>(100), loaded.GetSize());
+         for (INT_PTR i = 0; i < 100; ++i)
+            Assert::IsTrue(arr[i] == loaded[i]);
+      }
+
+      TEST_METHOD(TestBlob_Empty)
+      {
+         CByteArray arr;
+         CByteArray loaded;
+         loaded.Add(1);
+         RoundTrip(arr, loaded);
+
+         Assert::IsTrue(loaded.IsEmpty() != FALSE);
+      }
+
+      TEST_METHOD(TestBlob_File)
+      {
+         CWordArray arr;
+         for (WORD i = 0; i < 10; ++i) arr.Add(i);
+
+         CMemFile file;
+         mfc::write_blob(file, arr);
+         file.SeekToBegin();
+
+         CWordArray loaded;
+         mfc::read_blob(file, loaded);
+
+         Assert::AreEqual(arr.GetSize(), loaded.GetSize());
+         Assert::AreEqual(arr[9], loaded[9]);
+      }
+
+      TEST_METHOD(TestBlob_TypeMismatch)
+      {
+         CDWordArray arr;
+         arr.Add(1);
+
+         CUIntArray loaded;
+         Assert::ExpectException<CArchiveException*>([&]() { RoundTrip(arr, loaded); });
+      }
+
+      TEST_METHOD(TestBlob_ForeignByteOrder)
+      {
+         // a file written on a big-endian machine: the header is little-endian, the elements are not
+         mfc::detail::blob_header header = {};
+         header.signature = mfc::detail::blob_header::Signature;
+         header.version = mfc::detail::blob_header::Version;
+         header.endianness = mfc::detail::blob_header::BigEndian;
+         header.type_tag = mfc::blob_type_tag<DWORD>::value;
+         header.element_size = sizeof(DWORD);
+         header.count = 2;
+         DWORD const elements[] = { 0x04030201, 0x0D0C0B0A };
+
+         CMemFile file;
+         file.Write(&header, sizeof(header));
+         file.Write(elements, sizeof(elements));
+         file.SeekToBegin();
+
+         CDWordArray loaded;
+         mfc::read_blob(file, loaded);
+         Assert::AreEqual(static_cast<INT_PTR>(2), loaded.GetSize());
+         Assert::AreEqual(static_cast<DWORD>(0x01020304), loaded[0]);
+         Assert::AreEqual(static_cast<DWORD>(0x0A0B0C0D), loaded[1]);
+      }
+
+      TEST_METHOD(TestMappedArray_Read)
+      {
+         LPCTSTR const fileName = _T("mapped_array_test.bin");
+
+         CDWordArray arr;
+         for (DWORD i = 0; i < 1000; ++i) arr.Add(i * 3);
+
+         {
+            CFile file(fileName, CFile::modeCreate | CFile::modeWrite);
+            mfc::write_blob(file, arr);
+         }
+
+         {
+            mfc::CMappedArray<DWORD> mapped;
+            Assert::IsTrue(mapped.Open(fileName) != FALSE);
+            Assert::AreEqual(arr.GetSize(), mapped.GetSize());
+            Assert::IsTrue(std::equal(begin(arr), end(arr), begin(mapped)));
+
+            auto pos = std::lower_bound(begin(mapped), end(mapped), static_cast<DWORD>(300));
+            Assert::IsTrue(pos != end(mapped));
+            Assert::IsTrue(*pos == 300);
+            Assert::AreEqual(static_cast<INT_PTR>(100), pos - begin(mapped));
+         }
+
+         CFile::Remove(fileName);
+      }
+
+      TEST_METHOD(TestMappedArray_TypeMismatch)
+      {
+         LPCTSTR const fileName = _T("mapped_array_mismatch.bin");
+
+         CWordArray arr;
+         arr.Add(1);
+
+         {
+            CFile file(fileName, CFile::modeCreate | CFile::modeWrite);
+            mfc::write_blob(file, arr);
+         }
+
+         mfc::CMappedArray<DWORD> mapped;
+         Assert::IsFalse(mapped.Open(fileName) != FALSE);
+         Assert::IsFalse(mapped.IsOpen());
+
+         CFile::Remove(fileName);
+         Assert::IsFalse(mapped.Open(fileName) != FALSE);
+      }
+
+      TEST_METHOD(TestArchiveRange_StringList)
+      {
+         CStringList list;
+         for (int i = 0; i < 10; ++i)
+         {
+            CString str;
+            str.Format(_T("%d"), i);
+            list.AddTail(str);
+         }
+
+         CMemFile file;
+         Store(list, file);
+
+         CArchive ar(&file, CArchive::load);
+         auto range = mfc::archive_range<CStringList>(ar);
+         Assert::AreEqual(static_cast<DWORD_PTR>(10), range.GetCount());
+
+         POSITION pos = list.GetHeadPosition();
+         int count = 0;
+         for (CString const & str : range)
+         {
+            Assert::IsTrue(str == list.GetNext(pos));
+            ++count;
+         }
+
+         Assert::AreEqual(10, count);
+         Assert::AreEqual(static_cast<DWORD_PTR>(0), range.GetRemaining());
+      }
+
+      TEST_METHOD(TestArchiveRange_EarlyStop)
+      {
+         CArray<int> arr;
+         for (int i = 0; i < 100; ++i) arr.Add(i * 2);
+
+         CMemFile file;
+         Store(arr, file);
+
+         CArchive ar(&file, CArchive::load);
+         auto range = mfc::archive_range<CArray<int>>(ar);
+         auto pos = std::find(range.begin(), range.end(), 20);
+
+         Assert::IsTrue(pos != range.end());
+         Assert::AreEqual(20, *pos);
+         Assert::AreEqual(static_cast<DWORD_PTR>(89), range.GetRemaining());
+
+         ++pos;
+         Assert::AreEqual(22, *pos);
+
+         // begin() again returns the current element instead of reading the next one
+         Assert::AreEqual(22, *range.begin());
+         Assert::AreEqual(static_cast<DWORD_PTR>(88), range.GetRemaining());
+      }
+
+      TEST_METHOD(TestArchiveRange_Empty)
+      {
+         CStringList list;
+
+         CMemFile file;
+         Store(list, file);
+
+         CArchive ar(&file, CArchive::load);
+         auto range = mfc::archive_range<CStringList>(ar);
+         Assert::AreEqual(static_cast<DWORD_PTR>(0), range.GetCount());
+         Assert::IsTrue(range.begin() == range.end());
+
+         // begin() reads the first element only once, so calling it again does not read from the archive
+         Assert::IsTrue(range.begin() == range.end());
+         Assert::AreEqual(static_cast<DWORD_PTR>(0), range.GetRemaining());
+      }
+
+      TEST_METHOD(TestExportAsync_Array)
+      {
+         CArray<int> arr;
+         for (int i = 0; i < 10000; ++i) arr.Add(i);
+
+         CMemFile file;
+         auto done = mfc::export_async(file, arr, 1000);
+         arr.RemoveAll();
+         done.get();
+
+         file.SeekToBegin();
+         CArray<int> loaded;
+         mfc::read_blob(file, loaded);
+
+         Assert::AreEqual(static_cast<INT_PTR>(10000), loaded.GetSize());
+         for (int i = 0; i < 10000; ++i)
+            Assert::AreEqual(i, loaded[i]);
+      }
+
+      TEST_METHOD(TestExportAsync_List)
+      {
+         CList<double> list;
+         for (int i = 0; i < 100; ++i) list.AddTail(i * 0.5);
+
+         CMemFile file;
+         mfc::export_async(file, list, 64).get();
+
+         file.SeekToBegin();
+         CArray<double> loaded;
+         mfc::read_blob(file, loaded);
+
+         Assert::AreEqual(static_cast<INT_PTR>(100), loaded.GetSize());
+         Assert::AreEqual(49.5, loaded[99]);
+      }
+
+      TEST_METHOD(TestExportAsync_MapCallback)
+      {
+         CMap<int, int, int, int> map;
+         for (int i = 0; i < 500; ++i) map.SetAt(i, i * i);
+
+         std::promise<bool> completed;
+         CMemFile file;
+         mfc::export_async(file, map, [&completed](std::exception_ptr error) { completed.set_value(error == nullptr); });
+         Assert::IsTrue(completed.get_future().get());
+
+         file.SeekToBegin();
+         CArray<CMapPair<int, int>> loaded;
+         mfc::read_blob(file, loaded);
+
+         Assert::AreEqual(static_cast<INT_PTR>(500), loaded.GetSize());
+         for (INT_PTR i = 0; i < loaded.GetSize(); ++i)
+            Assert::AreEqual(loaded[i].key * loaded[i].key, loaded[i].value);
+      }
+
+      TEST_METHOD(TestExportAsync_BusyExecutor)
+      {
+         CArray<int> arr;
+         for (int i = 0; i < 10000; ++i) arr.Add(i);
+
+         // the only worker is blocked, so the calling thread has to write the buffers that do not fit
+         mfc::CThreadPool pool(1);
+         std::promise<void> release;
+         std::shared_future<void> const released = release.get_future().share();
+         pool.Submit([released]() { released.wait(); });
+
+         CMemFile file;
+         auto done = mfc::export_async(pool, file, arr, 1000);
+         Assert::IsTrue(file.GetLength() > 0);
+
+         release.set_value();
+         done.get();
+
+         file.SeekToBegin();
+         CArray<int> loaded;
+         mfc::read_blob(file, loaded);
+         Assert::AreEqual(static_cast<INT_PTR>(10000), loaded.GetSize());
+         Assert::AreEqual(9999, loaded[9999]);
+      }
+
+      TEST_METHOD(TestExportAsync_SerialExecutor)
+      {
+         CList<int> list;
+         for (int i = 0; i < 100; ++i) list.AddTail(i);
+
+         mfc::CSerialExecutor serial;
+         bool completed = false;
+         CMemFile file;
+         mfc::export_async(serial, file, list, [&completed](std::exception_ptr error) { completed = error == nullptr; }, 64);
+
+         // the serial executor runs every task inline, so the export has completed on return
+         Assert::IsTrue(completed);
+         file.SeekToBegin();
+         CArray<int> loaded;
+         mfc::read_blob(file, loaded);
+         Assert::AreEqual(static_cast<INT_PTR>(100), loaded.GetSize());
+      }
+   };
+}
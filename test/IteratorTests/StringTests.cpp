@@ -0,0 +1,289 @@
+#include "pch.h"
+#include "CppUnitTest.h"
+#include "..\..\include\mfciterators.h"
+#include "IntObject.h"
+
+#include "Specializations.h"  // last include
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+namespace IteratorTests
+{
+   TEST_CLASS(StringTests)
+   {
+   private:
+      static CStringArray& Tokens(CStringArray& arr)
+      {
+         arr.Add(_T("alpha"));
+         arr.Add(_T(""));
+         arr.Add(_T("gamma"));
+         arr.Add(_T("delta"));
+         return arr;
+      }
+
+      TEST_METHOD(TestPooledStrings_Add)
+      {
+         mfc::CPooledStringArray arr;
+         Assert::IsTrue(arr.IsEmpty() != FALSE);
+
+         Assert::AreEqual(static_cast<INT_PTR>(0), arr.Add(_T("one")));
+         Assert::AreEqual(static_cast<INT_PTR>(1), arr.Add(CString(_T("three"))));
+         Assert::AreEqual(static_cast<INT_PTR>(2), arr.Add(_T("fourteen"), 4));
+
+         Assert::AreEqual(static_cast<INT_PTR>(3), arr.GetSize());
+         Assert::AreEqual(_T("one"), arr[0]);
+         Assert::AreEqual(_T("three"), arr.GetAt(1));
+         Assert::AreEqual(_T("four"), arr[2]);
+         Assert::AreEqual(5, arr.GetLength(1));
+         Assert::AreEqual(static_cast<size_t>(15), arr.GetPoolSize());
+      }
+
+      TEST_METHOD(TestPooledStrings_Convert)
+      {
+         CStringArray source;
+         mfc::CPooledStringArray arr(Tokens(source));
+
+         Assert::AreEqual(source.GetSize(), arr.GetSize());
+         Assert::AreEqual(0, arr.GetLength(1));
+
+         CStringArray target;
+         target.Add(_T("stale"));
+         arr.CopyTo(target);
+
+         Assert::AreEqual(source.GetSize(), target.GetSize());
+         for (INT_PTR i = 0; i < source.GetSize(); ++i)
+            Assert::IsTrue(source[i] == target[i]);
+      }
+
+      TEST_METHOD(TestPooledStrings_Iterators)
+      {
+         CStringArray source;
+         mfc::CPooledStringArray arr(Tokens(source));
+
+         int count = 0;
+         for (LPCTSTR str : arr)
+         {
+            Assert::IsTrue(source[count] == str);
+            ++count;
+         }
+         Assert::AreEqual(4, count);
+
+         std::vector<LPCTSTR> sorted(begin(arr), end(arr));
+         std::sort(sorted.begin(), sorted.end(), [](LPCTSTR a, LPCTSTR b) { return _tcscmp(a, b) < 0; });
+         Assert::AreEqual(_T("alpha"), sorted[1]);
+
+         auto it = end(arr) - 1;
+         Assert::AreEqual(_T("delta"), *it);
+         Assert::AreEqual(static_cast<ptrdiff_t>(3), it - begin(arr));
+         Assert::AreEqual(_T("gamma"), begin(arr)[2]);
+      }
+
+      TEST_METHOD(TestInterner_Handles)
+      {
+         mfc::CStringInterner interner(16);
+
+         auto first = interner.Intern(_T("alpha"));
+         auto second = interner.Intern(CString(_T("alpha")));
+         auto third = interner.Intern(_T("alphabet"), 5);
+         auto other = interner.Intern(_T("beta"));
+
+         Assert::IsTrue(first == second);
+         Assert::IsTrue(first == third);
+         Assert::IsTrue(first != other);
+         Assert::AreEqual(_T("alpha"), first.GetString());
+         Assert::AreEqual(first.GetHash(), second.GetHash());
+         Assert::AreEqual(static_cast<INT_PTR>(2), interner.GetCount());
+
+         Assert::IsTrue(interner.Intern(_T("")) == mfc::CInternedString());
+         Assert::AreEqual(_T(""), mfc::CInternedString().GetString());
+
+         mfc::CInternedString found;
+         Assert::IsTrue(interner.Lookup(_T("beta"), found) != FALSE);
+         Assert::IsTrue(found == other);
+         Assert::IsFalse(interner.Lookup(_T("gamma"), found) != FALSE);
+      }
+
+      TEST_METHOD(TestInterner_Grow)
+      {
+         mfc::CStringInterner interner(64);
+
+         std::vector<mfc::CInternedString> handles;
+         for (int i = 0; i < 1000; ++i)
+         {
+            CString str;
+            str.Format(_T("key%d"), i);
+            handles.push_back(interner.Intern(str));
+         }
+
+         Assert::AreEqual(static_cast<INT_PTR>(1000), interner.GetCount());
+         for (int i = 0; i < 1000; ++i)
+         {
+            CString str;
+            str.Format(_T("key%d"), i);
+            Assert::IsTrue(handles[i] == interner.Intern(str));
+            Assert::IsTrue(str == handles[i].GetString());
+         }
+         Assert::AreEqual(static_cast<INT_PTR>(1000), interner.GetCount());
+      }
+
+      TEST_METHOD(TestInterner_Array)
+      {
+         CStringList list;
+         list.AddTail(_T("red"));
+         list.AddTail(_T("green"));
+         list.AddTail(_T("red"));
+
+         mfc::CStringInterner interner;
+         CArray<mfc::CInternedString> column;
+         mfc::intern_all(interner, list, column);
+
+         Assert::AreEqual(static_cast<INT_PTR>(3), column.GetSize());
+         Assert::AreEqual(static_cast<INT_PTR>(2), interner.GetCount());
+         Assert::IsTrue(column[0] == column[2]);
+
+         auto red = interner.Intern(_T("red"));
+         Assert::AreEqual(static_cast<ptrdiff_t>(2), std::count(begin(column), end(column), red));
+      }
+
+      TEST_METHOD(TestInterner_Map)
+      {
+         CMapStringToString map;
+         map.SetAt(_T("one"), _T("1"));
+         map.SetAt(_T("two"), _T("2"));
+
+         mfc::CStringInterner interner;
+         CMap<mfc::CInternedString, mfc::CInternedString, CString, LPCTSTR> interned;
+         mfc::intern_keys(interner, map, interned);
+
+         Assert::AreEqual(static_cast<INT_PTR>(2), interned.GetCount());
+
+         CString value;
+         Assert::IsTrue(interned.Lookup(interner.Intern(_T("two")), value) != FALSE);
+         Assert::IsTrue(value == _T("2"));
+
+         int count = 0;
+         for (auto const & pair : interned)
+         {
+            Assert::IsTrue(map[pair.key.GetString()] == pair.value);
+            ++count;
+         }
+         Assert::AreEqual(2, count);
+      }
+
+      TEST_METHOD(TestJoin_Array)
+      {
+         CStringArray arr;
+         Assert::IsTrue(mfc::join(arr, _T(", ")).IsEmpty());
+
+         arr.Add(_T("one"));
+         Assert::IsTrue(mfc::join(arr, _T(", ")) == _T("one"));
+
+         arr.Add(_T(""));
+         arr.Add(_T("three"));
+         Assert::IsTrue(mfc::join(arr, _T(", ")) == _T("one, , three"));
+         Assert::IsTrue(mfc::concat(arr) == _T("onethree"));
+      }
+
+      TEST_METHOD(TestJoin_List)
+      {
+         CStringList list;
+         list.AddTail(_T("a"));
+         list.AddTail(_T("b"));
+         list.AddTail(_T("c"));
+
+         Assert::IsTrue(mfc::join(list, _T("/")) == _T("a/b/c"));
+
+         mfc::CPooledStringArray pool;
+         pool.Add(_T("x"));
+         pool.Add(_T("y"));
+         Assert::IsTrue(mfc::join(pool, _T("+")) == _T("x+y"));
+      }
+
+      TEST_METHOD(TestJoin_Map)
+      {
+         CMapStringToString map;
+         map.SetAt(_T("key"), _T("value"));
+
+         Assert::IsTrue(mfc::join_keys(map, _T(";")) == _T("key"));
+         Assert::IsTrue(mfc::join_values(map, _T(";")) == _T("value"));
+
+         map.SetAt(_T("other"), _T("data"));
+         CString const keys = mfc::join_keys(map, _T(";"));
+         Assert::IsTrue(keys == _T("key;other") || keys == _T("other;key"));
+
+         CMap<int, int, CString, LPCTSTR> numbers;
+         numbers.SetAt(1, _T("first"));
+         Assert::IsTrue(mfc::join(numbers, _T(","), mfc::pair_value()) == _T("first"));
+      }
+
+      TEST_METHOD(TestSplit_Views)
+      {
+         CString const text = _T(",alpha,,beta,gamma,");
+
+         std::vector<CString> tokens;
+         for (auto const & token : mfc::split(text, _T(",")))
+            tokens.push_back(CString(token.data(), static_cast<int>(token.size())));
+
+         Assert::AreEqual(static_cast<size_t>(3), tokens.size());
+         Assert::IsTrue(tokens[0] == _T("alpha"));
+         Assert::IsTrue(tokens[2] == _T("gamma"));
+
+         auto const all = mfc::split(text, _T(","), mfc::empty_tokens::keep);
+         Assert::AreEqual(static_cast<ptrdiff_t>(6), std::distance(all.begin(), all.end()));
+         Assert::IsTrue((*all.begin()).empty());
+
+         Assert::IsTrue(mfc::join(mfc::split(text, _T(",")), _T("|")) == _T("alpha|beta|gamma"));
+      }
+
+      TEST_METHOD(TestSplit_DelimiterSet)
+      {
+         CString const text = _T("one two\tthree\r\nfour");
+         auto const tokens = mfc::split(text, _T(" \t\r\n"));
+         Assert::IsTrue(mfc::join(tokens, _T(",")) == _T("one,two,three,four"));
+
+         CString const empty;
+         auto const none = mfc::split(empty, _T(","));
+         Assert::IsTrue(none.begin() == none.end());
+      }
+
+      TEST_METHOD(TestSplit_LongText)
+      {
+         // delimiters inside and across 16-byte blocks and in the tail after the last full block
+         CString text;
+         CString expected;
+         for (int i = 0; i < 40; ++i)
+         {
+            CString word;
+            word.Format(_T("w%d"), i * 37);
+            text += word + (i % 3 == 0 ? _T(";") : i % 3 == 1 ? _T(" ") : _T("\t"));
+            expected += (i > 0 ? _T("|") : _T("")) + word;
+         }
+
+         Assert::IsTrue(mfc::join(mfc::split(text, _T("; \t")), _T("|")) == expected);
+         Assert::IsTrue(mfc::join(mfc::split(text, _T("; \t\r\n,")), _T("|")) == expected);
+         auto const groups = mfc::split(text, _T(";"));
+         Assert::AreEqual(static_cast<ptrdiff_t>(14), std::distance(groups.begin(), groups.end()));
+      }
+
+      TEST_METHOD(TestSplit_Into)
+      {
+         CString const text = _T("red;green;;blue");
+
+         CStringArray arr;
+         arr.Add(_T("stale"));
+         mfc::split_into(text, _T(";"), arr);
+
+         Assert::AreEqual(static_cast<INT_PTR>(3), arr.GetSize());
+         Assert::IsTrue(arr[2] == _T("blue"));
+         Assert::IsTrue(std::find(begin(arr), end(arr), CString(_T("green"))) != end(arr));
+
+         mfc::CPooledStringArray pool;
+         mfc::split_into(text, _T(";"), pool, mfc::empty_tokens::keep);
+
+         Assert::AreEqual(static_cast<INT_PTR>(4), pool.GetSize());
+         Assert::AreEqual(0, pool.GetLength(2));
+         Assert::AreEqual(_T("blue"), pool[3]);
+         Assert::AreEqual(static_cast<size_t>(16), pool.GetPoolSize());
+      }
+   };
+}
\ No newline at end of file
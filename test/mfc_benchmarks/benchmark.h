@@ -0,0 +1,39 @@
+#pragma once
+
+#include <chrono>
+#include <iostream>
+#include <iomanip>
+
+// best of 'repeat' runs, in milliseconds
+template <typename F>
+double measure_ms(F&& fn, int const repeat = 3)
+{
+   double best = 0;
+   for (int i = 0; i < repeat; ++i)
+   {
+      auto const start = std::chrono::high_resolution_clock::now();
+      fn();
+      auto const elapsed = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+      if (i == 0 || elapsed < best)
+         best = elapsed;
+   }
+
+   return best;
+}
+
+inline void report(char const * name, double const ms, double const baseline_ms)
+{
+   std::cout
+      << std::left << std::setw(48) << name
+      << std::right << std::setw(12) << std::fixed << std::setprecision(2) << ms << " ms"
+      << std::setw(10) << std::setprecision(2) << (ms > 0 ? baseline_ms / ms : 0) << "x" << std::endl;
+}
+
+void run_parallel_map_benchmark();
+void run_group_reduce_benchmark();
+void run_interned_strings_benchmark();
+void run_compaction_benchmark();
+void run_snapshot_benchmark();
+void run_ring_buffer_benchmark();
+void run_parallel_list_benchmark();
+void run_flat_view_benchmark();
@@ -0,0 +1,87 @@
+#include <SDKDDKVer.h>
+#include <afx.h>
+#include <afxwin.h>
+#include <afxext.h>
+
+#include <random>
+
+#include "..\..\include\mfciterators.h"
+#include "benchmark.h"
+
+namespace
+{
+   struct Order
+   {
+      double   amount;
+      int      quantity;
+      int      flags;
+      BYTE     padding[48];
+
+      explicit Order(int const i) : amount(i * 0.25), quantity(i % 7), flags(i & 3), padding() {}
+      Order(Order&&) = default;
+   };
+
+   // objects allocated among short-lived blocks of other sizes and stored in an order unrelated to their addresses
+   void populate(mfc::CCompactable<CTypedPtrArray<CPtrArray, Order*>>& orders, INT_PTR const count)
+   {
+      std::mt19937 random(42);
+      std::uniform_int_distribution<int> sizes(16, 512);
+
+      std::vector<void*> churn;
+      churn.reserve(static_cast<size_t>(count) * 4);
+
+      orders.SetSize(count);
+      for (INT_PTR i = 0; i < count; ++i)
+      {
+         for (int j = 0; j < 4; ++j)
+            churn.push_back(::operator new(sizes(random)));
+         orders[i] = new Order(static_cast<int>(i));
+      }
+
+      for (void* block : churn)
+         ::operator delete(block);
+
+      for (INT_PTR i = count - 1; i > 0; --i)
+      {
+         INT_PTR const j = static_cast<INT_PTR>(random() % static_cast<unsigned>(i + 1));
+         Order* const tmp = orders[i];
+         orders[i] = orders[j];
+         orders[j] = tmp;
+      }
+   }
+
+   double traverse(mfc::CCompactable<CTypedPtrArray<CPtrArray, Order*>>& orders)
+   {
+      double total = 0;
+      for (Order* order : orders)
+         total += order->amount * order->quantity + order->flags;
+      return total;
+   }
+
+   void benchmark_compaction(INT_PTR const count)
+   {
+      mfc::CCompactable<CTypedPtrArray<CPtrArray, Order*>> orders;
+      populate(orders, count);
+
+      double total = 0;
+      auto const scattered = measure_ms([&]() { total = traverse(orders); });
+      auto const compaction = measure_ms([&]() { orders.Compact(); }, 1);
+      auto const compacted = measure_ms([&]() { total = traverse(orders); });
+
+      std::cout << "CTypedPtrArray<CPtrArray, Order*>, " << count << " objects of " << sizeof(Order) << " bytes" << std::endl;
+      report("  range-for, scattered objects", scattered, scattered);
+      report("  range-for, after Compact", compacted, scattered);
+      report("  Compact", compaction, scattered);
+      std::cout << "  (checksum " << total << ")" << std::endl;
+
+      orders.DeleteAll();
+   }
+}
+
+void run_compaction_benchmark()
+{
+   std::cout << "Pointer compaction" << std::endl;
+
+   for (INT_PTR const count : { 100000, 2000000 })
+      benchmark_compaction(count);
+}
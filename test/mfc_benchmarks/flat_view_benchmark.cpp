@@ -0,0 +1,60 @@
+#include <SDKDDKVer.h>
+#include <afx.h>
+#include <afxwin.h>
+#include <afxext.h>
+
+#include "..\..\include\mfciterators.h"
+#include "benchmark.h"
+
+namespace
+{
+   struct Sample
+   {
+      double   value;
+      double   weight;
+      int      channel;
+   };
+
+   void benchmark_repeated_scans(INT_PTR const count, int const scans)
+   {
+      CList<Sample> list;
+      std::vector<std::unique_ptr<char[]>> unrelated;
+      for (INT_PTR i = 0; i < count; ++i)
+      {
+         Sample const sample = { static_cast<double>(i % 1000), 0.5, static_cast<int>(i % 16) };
+         list.AddTail(sample);
+
+         // interleave unrelated allocations so the nodes are scattered as in a long-running program
+         if (i % 3 == 0)
+            unrelated.emplace_back(new char[48]);
+      }
+
+      double total = 0;
+
+      auto const nodes = measure_ms([&]() {
+         for (int scan = 0; scan < scans; ++scan)
+            for (auto const & sample : list)
+               total += sample.value * sample.weight;
+      });
+
+      auto const flat = measure_ms([&]() {
+         auto const view = mfc::flat_view(list);
+         for (int scan = 0; scan < scans; ++scan)
+            for (auto const & sample : view)
+               total += sample.value * sample.weight;
+      });
+
+      std::cout << "CList<Sample>, " << count << " samples, " << scans << " scans" << std::endl;
+      report("  range-for over the list", nodes, nodes);
+      report("  mfc::flat_view (one copy, then array scans)", flat, nodes);
+      std::cout << "  (checksum " << total << ")" << std::endl;
+   }
+}
+
+void run_flat_view_benchmark()
+{
+   std::cout << "Flat list views" << std::endl;
+
+   benchmark_repeated_scans(100000, 30);
+   benchmark_repeated_scans(1000000, 30);
+}
@@ -0,0 +1,66 @@
+#include <SDKDDKVer.h>
+#include <afx.h>
+#include <afxwin.h>
+#include <afxext.h>
+
+#include <functional>
+
+#include "..\..\include\mfciterators.h"
+#include "benchmark.h"
+
+namespace
+{
+   struct Record
+   {
+      int      key;
+      double   amount;
+   };
+
+   void benchmark_group_reduce(INT_PTR const count, int const keys)
+   {
+      CArray<Record> records;
+      records.SetSize(count);
+      for (INT_PTR i = 0; i < count; ++i)
+      {
+         records[i].key = static_cast<int>((i * 7919) % keys);
+         records[i].amount = static_cast<double>(i % 100);
+      }
+
+      UINT const hash_size = mfc::detail::hash_table_size(keys);
+
+      auto const serial = measure_ms([&]() {
+         CMap<int, int, double, double> sums;
+         sums.InitHashTable(hash_size);
+         for (auto const & record : records)
+         {
+            auto pair = sums.PLookup(record.key);
+            if (pair == nullptr)
+               sums.SetAt(record.key, record.amount);
+            else
+               pair->value += record.amount;
+         }
+      });
+
+      auto const parallel = measure_ms([&]() {
+         CMap<int, int, double, double> sums;
+         mfc::group_reduce(records,
+            [](Record const & r) { return r.key; },
+            [](Record const & r) { return r.amount; },
+            std::plus<double>(),
+            sums,
+            hash_size);
+      });
+
+      std::cout << "CArray<Record> -> CMap<int, double>, " << count << " records, " << keys << " keys" << std::endl;
+      report("  range-for with PLookup/SetAt", serial, serial);
+      report("  mfc::group_reduce", parallel, serial);
+   }
+}
+
+void run_group_reduce_benchmark()
+{
+   std::cout << "Parallel group-by (" << std::thread::hardware_concurrency() << " hardware threads)" << std::endl;
+
+   for (int const keys : { 16, 1000, 100000 })
+      benchmark_group_reduce(10000000, keys);
+}
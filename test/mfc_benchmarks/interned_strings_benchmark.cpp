@@ -0,0 +1,92 @@
+#include <SDKDDKVer.h>
+#include <afx.h>
+#include <afxwin.h>
+#include <afxext.h>
+
+#include "..\..\include\mfciterators.h"
+#include "benchmark.h"
+
+namespace
+{
+   // CString with its own buffer: the element, the CStringData header and the characters
+   size_t string_bytes(CString const & str)
+   {
+      return sizeof(CString) + sizeof(CStringData) + (str.GetLength() + 1) * sizeof(TCHAR);
+   }
+
+   void benchmark_interned_strings(INT_PTR const count, int const distinct)
+   {
+      CStringArray column;
+      column.SetSize(count);
+      size_t column_bytes = 0;
+      for (INT_PTR i = 0; i < count; ++i)
+      {
+         column[i].Format(_T("customer-%08d"), static_cast<int>((i * 7919) % distinct));
+         column_bytes += string_bytes(column[i]);
+      }
+
+      CMapStringToPtr lookup;
+      lookup.InitHashTable(mfc::detail::hash_table_size(distinct));
+      for (int i = 0; i < distinct; ++i)
+      {
+         CString key;
+         key.Format(_T("customer-%08d"), i);
+         lookup.SetAt(key, reinterpret_cast<void*>(static_cast<INT_PTR>(i)));
+      }
+
+      mfc::CStringInterner interner;
+      CArray<mfc::CInternedString> interned;
+      auto const intern = measure_ms([&]() { mfc::intern_all(interner, column, interned); }, 1);
+
+      CMap<mfc::CInternedString, mfc::CInternedString, void*, void*> interned_lookup;
+      mfc::intern_keys(interner, lookup, interned_lookup);
+
+      size_t const interned_bytes = interned.GetSize() * sizeof(mfc::CInternedString) + interner.GetAllocatedBytes();
+
+      CString const target = column[count / 2];
+      mfc::CInternedString const interned_target = interned[count / 2];
+      INT_PTR matches = 0;
+
+      auto const scan = measure_ms([&]() {
+         matches = 0;
+         for (auto const & str : column)
+            if (str == target) ++matches;
+      });
+
+      auto const interned_scan = measure_ms([&]() {
+         matches = 0;
+         for (auto const & handle : interned)
+            if (handle == interned_target) ++matches;
+      });
+
+      INT_PTR sum = 0;
+      auto const lookups = measure_ms([&]() {
+         void* value = nullptr;
+         for (auto const & str : column)
+            if (lookup.Lookup(str, value)) sum += reinterpret_cast<INT_PTR>(value);
+      });
+
+      auto const interned_lookups = measure_ms([&]() {
+         void* value = nullptr;
+         for (auto const & handle : interned)
+            if (interned_lookup.Lookup(handle, value)) sum += reinterpret_cast<INT_PTR>(value);
+      });
+
+      std::cout << "CStringArray column, " << count << " strings, " << distinct << " distinct" << std::endl;
+      std::cout << "  memory: CStringArray " << column_bytes / 1024 << " KB, interned " << interned_bytes / 1024 << " KB" << std::endl;
+      report("  mfc::intern_all", intern, intern);
+      report("  count equal, CString ==", scan, scan);
+      report("  count equal, CInternedString ==", interned_scan, scan);
+      report("  CMapStringToPtr::Lookup", lookups, lookups);
+      report("  CMap<CInternedString>::Lookup", interned_lookups, lookups);
+      std::cout << "  (" << matches << " matches, checksum " << sum << ")" << std::endl;
+   }
+}
+
+void run_interned_strings_benchmark()
+{
+   std::cout << "String interning" << std::endl;
+
+   for (int const distinct : { 100, 5000 })
+      benchmark_interned_strings(2000000, distinct);
+}
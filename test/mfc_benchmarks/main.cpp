@@ -0,0 +1,18 @@
+#include <SDKDDKVer.h>
+#include <afx.h>
+#include <afxwin.h>
+#include <afxext.h>
+
+#include "benchmark.h"
+
+int main()
+{
+   run_parallel_map_benchmark();
+   run_group_reduce_benchmark();
+   run_interned_strings_benchmark();
+   run_compaction_benchmark();
+   run_snapshot_benchmark();
+   run_ring_buffer_benchmark();
+   run_parallel_list_benchmark();
+   run_flat_view_benchmark();
+}
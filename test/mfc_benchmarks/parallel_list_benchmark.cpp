@@ -0,0 +1,74 @@
+#include <SDKDDKVer.h>
+#include <afx.h>
+#include <afxwin.h>
+#include <afxext.h>
+
+#include "..\..\include\mfciterators.h"
+#include "benchmark.h"
+
+namespace
+{
+   inline __int64 mix(__int64 v)
+   {
+      for (int i = 0; i < 16; ++i)
+         v = (v ^ (v >> 31)) * 0x7fb5d329728ea185LL;
+      return v;
+   }
+
+   void benchmark_list(INT_PTR const count)
+   {
+      CList<__int64> list;
+      for (INT_PTR i = 0; i < count; ++i)
+         list.AddTail(i);
+
+      auto const serial = measure_ms([&list]() {
+         for (auto & value : list)
+            value = mix(value);
+      });
+
+      // the previous approach: collect every POSITION, then split the vector
+      auto const positions = measure_ms([&list]() {
+         std::vector<POSITION> all;
+         all.reserve(static_cast<size_t>(list.GetCount()));
+         for (POSITION pos = list.GetHeadPosition(); pos != nullptr; list.GetNext(pos))
+            all.push_back(pos);
+
+         INT_PTR const chunks = mfc::default_executor().GetConcurrency() * 16;
+         mfc::default_executor().Bulk(chunks, [&](INT_PTR const chunk) {
+            size_t const from = all.size() * chunk / chunks;
+            size_t const to = all.size() * (chunk + 1) / chunks;
+            for (size_t i = from; i < to; ++i)
+               list.GetAt(all[i]) = mix(list.GetAt(all[i]));
+         });
+      });
+
+      auto const skip_table = measure_ms([&list]() {
+         mfc::parallel::for_each(list, [](__int64& value) { value = mix(value); });
+      });
+
+      mfc::CListSkipTable<CList<__int64>> table;
+      table.Build(list);
+      auto const cached = measure_ms([&list, &table]() {
+         mfc::parallel::for_each(list, table, [](__int64& value) { value = mix(value); });
+      });
+
+      __int64 checksum = 0;
+      for (auto const value : list)
+         checksum ^= value;
+
+      std::cout << "CList<__int64>, " << count << " nodes" << std::endl;
+      report("  range-for", serial, serial);
+      report("  vector of POSITIONs + parallel", positions, serial);
+      report("  mfc::parallel::for_each (skip table)", skip_table, serial);
+      report("  mfc::parallel::for_each (cached table)", cached, serial);
+      std::cout << "  (checksum " << checksum << ")" << std::endl;
+   }
+}
+
+void run_parallel_list_benchmark()
+{
+   std::cout << "Parallel list traversal" << std::endl;
+
+   benchmark_list(1000000);
+   benchmark_list(10000000);
+}
@@ -0,0 +1,79 @@
+#include <SDKDDKVer.h>
+#include <afx.h>
+#include <afxwin.h>
+#include <afxext.h>
+
+#include "..\..\include\mfciterators.h"
+#include "benchmark.h"
+
+namespace
+{
+   inline __int64 mix(__int64 v)
+   {
+      for (int i = 0; i < 16; ++i)
+         v = (v ^ (v >> 31)) * 0x7fb5d329728ea185LL;
+      return v;
+   }
+
+   void benchmark_template_map(INT_PTR const count)
+   {
+      CMap<__int64, __int64, __int64, __int64> map;
+      map.InitHashTable(static_cast<UINT>(count + count / 4) | 1);
+      for (INT_PTR i = 0; i < count; ++i)
+         map[i] = i;
+
+      auto const serial = measure_ms([&map]() {
+         for (auto & kvp : map)
+            kvp.value = mix(kvp.value);
+      });
+
+      auto const parallel = measure_ms([&map]() {
+         mfc::parallel::for_each(map, [](CMap<__int64, __int64, __int64, __int64>::CPair& kvp) {
+            kvp.value = mix(kvp.value);
+         });
+      });
+
+      std::cout << "CMap<__int64, __int64>, " << count << " entries" << std::endl;
+      report("  range-for", serial, serial);
+      report("  mfc::parallel::for_each", parallel, serial);
+   }
+
+   void benchmark_word_map()
+   {
+      CMapWordToPtr map;
+      map.InitHashTable(65521);
+      for (UINT i = 0; i <= 0xFFFF; ++i)
+         map[static_cast<WORD>(i)] = reinterpret_cast<void*>(static_cast<INT_PTR>(i));
+
+      std::atomic<__int64> total(0);
+
+      auto const serial = measure_ms([&]() {
+         __int64 sum = 0;
+         for (auto const & kvp : map)
+            sum += mix(reinterpret_cast<INT_PTR>(kvp.value));
+         total += sum;
+      });
+
+      auto const parallel = measure_ms([&]() {
+         mfc::parallel::for_each(map, [&total](CMapPair<WORD, void*> const & kvp) {
+            auto const value = mix(reinterpret_cast<INT_PTR>(kvp.value));
+            if (value == 0)
+               total++;
+         });
+      });
+
+      std::cout << "CMapWordToPtr, 65536 entries" << std::endl;
+      report("  range-for", serial, serial);
+      report("  mfc::parallel::for_each", parallel, serial);
+   }
+}
+
+void run_parallel_map_benchmark()
+{
+   std::cout << "Parallel map traversal (" << std::thread::hardware_concurrency() << " hardware threads)" << std::endl;
+
+   for (INT_PTR const count : { 100000, 1000000, 5000000, 20000000 })
+      benchmark_template_map(count);
+
+   benchmark_word_map();
+}
@@ -0,0 +1,158 @@
+#include <SDKDDKVer.h>
+#include <afx.h>
+#include <afxwin.h>
+#include <afxext.h>
+#include <afxmt.h>
+
+#include "..\..\include\mfciterators.h"
+#include "benchmark.h"
+
+namespace
+{
+   typedef std::chrono::steady_clock clock_type;
+
+   struct WorkItem
+   {
+      int                     id;
+      clock_type::time_point  queued;
+   };
+
+   // the producer/consumer hand-off this replaces: a CList guarded by a critical section
+   class CLockedList
+   {
+   public:
+      void Push(WorkItem const & item)
+      {
+         CSingleLock lock(&m_lock, TRUE);
+         m_items.AddTail(item);
+      }
+
+      template <typename Fn>
+      INT_PTR Drain(Fn&& fn)
+      {
+         CSingleLock lock(&m_lock, TRUE);
+         INT_PTR const count = m_items.GetCount();
+         while (!m_items.IsEmpty())
+            fn(m_items.RemoveHead());
+         return count;
+      }
+
+   private:
+      CCriticalSection  m_lock;
+      CList<WorkItem>   m_items;
+   };
+
+   template <typename R>
+   INT_PTR drain(R& ring, std::vector<double>& latencies, __int64& checksum)
+   {
+      auto batch = ring.Drain();
+      auto const now = clock_type::now();
+      for (auto const & item : batch)
+      {
+         latencies.push_back(std::chrono::duration<double, std::micro>(now - item.queued).count());
+         checksum += item.id;
+      }
+      return batch.GetSize();
+   }
+
+   INT_PTR drain(CLockedList& list, std::vector<double>& latencies, __int64& checksum)
+   {
+      auto const now = clock_type::now();
+      return list.Drain([&](WorkItem const & item) {
+         latencies.push_back(std::chrono::duration<double, std::micro>(now - item.queued).count());
+         checksum += item.id;
+      });
+   }
+
+   // runs the producers and one consumer; returns elapsed milliseconds and fills the per-item latencies
+   template <typename Q>
+   double run(Q& queue, int const producers, int const count, std::vector<double>& latencies, __int64& checksum)
+   {
+      latencies.clear();
+      latencies.reserve(static_cast<size_t>(producers) * count);
+
+      auto const start = clock_type::now();
+
+      std::vector<std::thread> threads;
+      for (int p = 0; p < producers; ++p)
+      {
+         threads.emplace_back([&queue, p, count]() {
+            for (int i = 0; i < count; ++i)
+            {
+               WorkItem const item = { p * count + i, clock_type::now() };
+               queue.Push(item);
+            }
+         });
+      }
+
+      INT_PTR received = 0;
+      while (received < static_cast<INT_PTR>(producers) * count)
+      {
+         INT_PTR const drained = drain(queue, latencies, checksum);
+         if (drained == 0)
+            std::this_thread::yield();
+         received += drained;
+      }
+
+      for (auto& thread : threads)
+         thread.join();
+
+      return std::chrono::duration<double, std::milli>(clock_type::now() - start).count();
+   }
+
+   double percentile(std::vector<double>& values, double const fraction)
+   {
+      auto const nth = values.begin() + static_cast<ptrdiff_t>(fraction * (values.size() - 1));
+      std::nth_element(values.begin(), nth, values.end());
+      return *nth;
+   }
+
+   void print_latency(std::vector<double>& latencies, int const items, double const ms)
+   {
+      std::cout
+         << "    " << std::fixed << std::setprecision(1) << items / ms / 1000.0 << " M items/s, latency us"
+         << " p50 " << percentile(latencies, 0.50)
+         << " p99 " << percentile(latencies, 0.99)
+         << " p99.9 " << percentile(latencies, 0.999) << std::endl;
+   }
+
+   void benchmark_hand_off(int const producers, int const count)
+   {
+      int const items = producers * count;
+      __int64 checksum = 0;
+      std::vector<double> latencies;
+
+      CLockedList list;
+      auto const locked = run(list, producers, count, latencies, checksum);
+      report("  CList + CCriticalSection", locked, locked);
+      print_latency(latencies, items, locked);
+
+      double ring_ms = 0;
+      if (producers == 1)
+      {
+         mfc::CSpscRing<WorkItem> ring(4096);
+         ring_ms = run(ring, producers, count, latencies, checksum);
+         report("  CSpscRing", ring_ms, locked);
+      }
+      else
+      {
+         mfc::CMpscRing<WorkItem> ring(4096);
+         ring_ms = run(ring, producers, count, latencies, checksum);
+         report("  CMpscRing", ring_ms, locked);
+      }
+      print_latency(latencies, items, ring_ms);
+
+      std::cout << "  (checksum " << checksum << ")" << std::endl;
+   }
+}
+
+void run_ring_buffer_benchmark()
+{
+   std::cout << "Producer/consumer ring buffers" << std::endl;
+
+   std::cout << "1 producer, 1000000 items" << std::endl;
+   benchmark_hand_off(1, 1000000);
+
+   std::cout << "4 producers, 250000 items each" << std::endl;
+   benchmark_hand_off(4, 250000);
+}
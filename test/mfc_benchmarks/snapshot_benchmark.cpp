@@ -0,0 +1,124 @@
+#include <SDKDDKVer.h>
+#include <afx.h>
+#include <afxwin.h>
+#include <afxext.h>
+
+#include "..\..\include\mfciterators.h"
+#include "benchmark.h"
+
+namespace
+{
+   struct Quote
+   {
+      int      instrument;
+      double   bid;
+      double   ask;
+      __int64  timestamp;
+   };
+
+   double spread(CArray<Quote> const & quotes)
+   {
+      double total = 0;
+      for (auto const & quote : quotes)
+         total += quote.ask - quote.bid;
+      return total;
+   }
+
+   void benchmark_array_snapshots(INT_PTR const count, int const readers)
+   {
+      mfc::CCopyOnWrite<CArray<Quote>> shared;
+      shared.Modify([count](CArray<Quote>& quotes) {
+         quotes.SetSize(count);
+         for (INT_PTR i = 0; i < count; ++i)
+         {
+            quotes[i].instrument = static_cast<int>(i % 500);
+            quotes[i].bid = 100.0 + (i % 100) * 0.01;
+            quotes[i].ask = quotes[i].bid + 0.02;
+            quotes[i].timestamp = i;
+         }
+      });
+
+      CArray<Quote> source;
+      source.Copy(*shared.Snapshot());
+
+      double total = 0;
+
+      auto const copies = measure_ms([&]() {
+         for (int i = 0; i < readers; ++i)
+         {
+            CArray<Quote> copy;
+            copy.Copy(source);
+            total += spread(copy);
+         }
+      });
+
+      auto const snapshots = measure_ms([&]() {
+         for (int i = 0; i < readers; ++i)
+         {
+            auto const snapshot = shared.Snapshot();
+            total += spread(*snapshot);
+         }
+      });
+
+      auto const write = measure_ms([&]() {
+         auto const held = shared.Snapshot();
+         shared.Modify([](CArray<Quote>& quotes) { quotes[0].bid += 0.01; });
+      });
+
+      std::cout << "CArray<Quote>, " << count << " quotes, " << readers << " readers" << std::endl;
+      report("  full copy per reader", copies, copies);
+      report("  snapshot per reader", snapshots, copies);
+      report("  write with an outstanding snapshot (clone)", write, write);
+      std::cout << "  (checksum " << total << ")" << std::endl;
+   }
+
+   void benchmark_map_snapshots(int const count, int const readers)
+   {
+      typedef CMap<int, int, double, double> price_map;
+
+      mfc::CCopyOnWrite<price_map> shared;
+      shared.Modify([count](price_map& prices) {
+         prices.InitHashTable(mfc::detail::hash_table_size(count));
+         for (int i = 0; i < count; ++i)
+            prices.SetAt(i, i * 0.5);
+      });
+
+      double total = 0;
+
+      auto const copies = measure_ms([&]() {
+         auto const source = shared.Snapshot();
+         for (int i = 0; i < readers; ++i)
+         {
+            price_map copy;
+            copy.InitHashTable(source->GetHashTableSize());
+            for (auto const & pair : source)
+               copy.SetAt(pair.key, pair.value);
+
+            for (auto const & pair : copy)
+               total += pair.value;
+         }
+      });
+
+      auto const snapshots = measure_ms([&]() {
+         for (int i = 0; i < readers; ++i)
+         {
+            auto const snapshot = shared.Snapshot();
+            for (auto const & pair : snapshot)
+               total += pair.value;
+         }
+      });
+
+      std::cout << "CMap<int, double>, " << count << " entries, " << readers << " readers" << std::endl;
+      report("  full copy per reader", copies, copies);
+      report("  snapshot per reader", snapshots, copies);
+      std::cout << "  (checksum " << total << ")" << std::endl;
+   }
+}
+
+void run_snapshot_benchmark()
+{
+   std::cout << "Copy-on-write snapshots" << std::endl;
+
+   benchmark_array_snapshots(1000000, 20);
+   benchmark_map_snapshots(200000, 20);
+}